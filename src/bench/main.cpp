@@ -0,0 +1,430 @@
+#include "channel.hpp"
+#include "ecs.hpp"
+#include "frame-pool.hpp"
+#include "task.hpp"
+#include "thread-pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <random>
+#include <span>
+#include <string_view>
+#include <vector>
+
+struct Payload {
+    float x = 0.f;
+    float y = 0.f;
+    float vx = 0.f;
+    float vy = 0.f;
+};
+
+// The same payload, kept at stable addresses.
+struct StablePayload : Payload { };
+
+template <>
+constexpr bool stableStorage<StablePayload> = true;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Tag {
+    int value = 0;
+};
+
+// The entity index ComponentStorage used before the sparse set, kept here as a
+// baseline to compare against.
+template <class Component>
+class MapIndexedStorage {
+public:
+    Component& component(Entity entity)
+    {
+        return _components.at(_componentIndexByEntity.at(entity));
+    }
+
+    Component& add(Entity entity, const Component& component)
+    {
+        _componentIndexByEntity[entity] = _components.size();
+        _entities.push_back(entity);
+        _components.push_back(component);
+        return _components.back();
+    }
+
+    void kill(Entity entity)
+    {
+        auto index = _componentIndexByEntity.at(entity);
+        if (index + 1 < _entities.size()) {
+            std::swap(_entities.at(index), _entities.back());
+            std::swap(_components.at(index), _components.back());
+            auto movedEntity = _entities.at(index);
+            _componentIndexByEntity.at(movedEntity) = index;
+        }
+        _entities.pop_back();
+        _components.pop_back();
+        _componentIndexByEntity.erase(entity);
+    }
+
+private:
+    std::vector<Entity> _entities;
+    std::vector<Component> _components;
+    std::map<Entity, size_t> _componentIndexByEntity;
+};
+
+void report(std::string_view name, size_t operations, Clock::duration time)
+{
+    auto seconds = std::chrono::duration<double>(time).count();
+    std::cout << "  " << name << ": " << operations / seconds / 1e6
+              << " Mops/s\n";
+}
+
+template <class Storage, class Value = Payload>
+void benchmarkStorage(std::string_view name, std::span<const Entity> order)
+{
+    std::cout << name << "\n";
+
+    auto storage = Storage{};
+    for (auto entity : order) {
+        storage.add(entity, Value{});
+    }
+
+    static constexpr int lookupRounds = 10;
+    auto start = Clock::now();
+    auto sum = 0.f;
+    for (int round = 0; round < lookupRounds; round++) {
+        for (auto entity : order) {
+            auto& payload = storage.component(entity);
+            payload.x += 1.f;
+            sum += payload.y;
+        }
+    }
+    report("lookup", order.size() * lookupRounds, Clock::now() - start);
+
+    start = Clock::now();
+    for (auto entity : order) {
+        storage.kill(entity);
+    }
+    report("kill", order.size(), Clock::now() - start);
+
+    if (sum != 0.f) {
+        std::cout << "  (unexpected checksum)\n";
+    }
+}
+
+template <class EcsType>
+void benchmarkEcs(std::string_view name, std::span<const Entity> order)
+{
+    std::cout << name << "\n";
+
+    auto ecs = EcsType{};
+    auto entities = std::vector<Entity>{};
+    entities.reserve(order.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        auto entity = ecs.create();
+        ecs.add(entity, Payload{.vx = 1.f, .vy = 1.f});
+        if (i % 2 == 0) {
+            ecs.add(entity, Tag{.value = 1});
+        }
+        entities.push_back(entity);
+    }
+
+    static constexpr int iterationRounds = 10;
+    auto start = Clock::now();
+    for (int round = 0; round < iterationRounds; round++) {
+        for (auto [entity, payload] : ecs.template view<Payload>()) {
+            payload.x += payload.vx;
+            payload.y += payload.vy;
+        }
+    }
+    report(
+        "view<Payload>", order.size() * iterationRounds, Clock::now() - start);
+
+    start = Clock::now();
+    auto sum = 0;
+    for (int round = 0; round < iterationRounds; round++) {
+        for (auto [entity, payload, tag] : ecs.template view<Payload, Tag>()) {
+            payload.x += static_cast<float>(tag.value);
+            sum += tag.value;
+        }
+    }
+    report(
+        "view<Payload, Tag>",
+        order.size() / 2 * iterationRounds,
+        Clock::now() - start);
+
+    start = Clock::now();
+    for (auto index : order) {
+        ecs.template component<Payload>(entities[index]).x += 1.f;
+    }
+    report("lookup", order.size(), Clock::now() - start);
+
+    start = Clock::now();
+    for (auto index : order) {
+        ecs.kill(entities[index]);
+    }
+    report("kill", order.size(), Clock::now() - start);
+
+    if (sum == 0) {
+        std::cout << "  (unexpected checksum)\n";
+    }
+}
+
+// Keeps a population of entityCount entities and despawns a random half of
+// them every tick, respawning the same amount afterwards.
+template <class EcsType>
+void benchmarkMassDespawn(std::string_view name, size_t entityCount)
+{
+    std::cout << name << "\n";
+
+    auto ecs = EcsType{};
+    auto entities = std::vector<Entity>{};
+    entities.reserve(entityCount);
+    auto spawn = [&ecs, &entities, entityCount] {
+        while (entities.size() < entityCount) {
+            auto entity = ecs.create();
+            ecs.add(entity, Payload{});
+            if (entity.index() % 2 == 0) {
+                ecs.add(entity, Tag{});
+            }
+            entities.push_back(entity);
+        }
+    };
+
+    auto engine = std::mt19937{42};
+    auto killTime = Clock::duration{};
+    static constexpr int ticks = 5;
+    for (int tick = 0; tick < ticks; tick++) {
+        spawn();
+        std::ranges::shuffle(entities, engine);
+
+        auto doomed = std::span{entities}.first(entities.size() / 2);
+        auto start = Clock::now();
+        ecs.killMany(doomed);
+        killTime += Clock::now() - start;
+
+        entities.erase(entities.begin(), entities.begin() + doomed.size());
+    }
+    report("killMany", entityCount / 2 * ticks, killTime);
+}
+
+// Respawns entityCount entities every tick through the command buffers, the
+// way systems request structural changes while iterating.
+template <class EcsType>
+void benchmarkCommands(std::string_view name, size_t entityCount)
+{
+    std::cout << name << "\n";
+
+    auto ecs = EcsType{};
+    auto entities = std::vector<Entity>{};
+    entities.reserve(entityCount);
+
+    auto recordTime = Clock::duration{};
+    auto flushTime = Clock::duration{};
+    static constexpr int ticks = 5;
+    for (int tick = 0; tick < ticks; tick++) {
+        auto start = Clock::now();
+        auto& commands = ecs.commands();
+        for (auto entity : entities) {
+            commands.kill(entity);
+        }
+        entities.clear();
+        for (size_t i = 0; i < entityCount; i++) {
+            auto entity = commands.create();
+            commands.add(entity, Payload{});
+            entities.push_back(entity);
+        }
+        recordTime += Clock::now() - start;
+
+        if (ecs.alive(entities.front())) {
+            std::cout << "  (reserved entity alive before flush)\n";
+        }
+
+        start = Clock::now();
+        ecs.flush();
+        flushTime += Clock::now() - start;
+    }
+    report("record", entityCount * ticks, recordTime);
+    report("flush", entityCount * ticks, flushTime);
+
+    if (!std::ranges::all_of(
+            entities, [&ecs](Entity entity) { return ecs.alive(entity); })) {
+        std::cout << "  (committed entity not alive)\n";
+    }
+}
+
+struct PositionEvent {
+    uint32_t id = 0;
+    float x = 0.f;
+    float y = 0.f;
+};
+
+// Kept on its own cache line, so that groups running on different threads do
+// not share one.
+struct alignas(64) Sum {
+    double value = 0.0;
+};
+
+// Delivers eventCount events per tick to several pool handler groups, first
+// all on the calling thread, then with the groups spread over a thread pool.
+void benchmarkChannel(size_t eventCount)
+{
+    static constexpr size_t groupCount = 8;
+    static constexpr int ticks = 5;
+
+    auto pool = ThreadPool{};
+    auto serialSums = std::vector<Sum>{};
+    for (auto onPool : {false, true}) {
+        std::cout << (onPool ? "deliver(ThreadPool&)\n" : "deliver()\n");
+
+        auto channel = Channel{};
+        auto sums = std::vector<Sum>(groupCount);
+        auto lifeHolders = std::vector<LifeHolder>{};
+        for (auto& sum : sums) {
+            auto group =
+                channel.addGroup({.affinity = HandlerAffinity::Pool});
+            lifeHolders.push_back(channel.subscribe<PositionEvent>(
+                [&sum](const PositionEvent& event) {
+                    sum.value += std::hypot(event.x, event.y);
+                },
+                group));
+        }
+
+        auto deliverTime = Clock::duration{};
+        for (int tick = 0; tick < ticks; tick++) {
+            for (size_t i = 0; i < eventCount; i++) {
+                channel.push(PositionEvent{
+                    .id = static_cast<uint32_t>(i),
+                    .x = static_cast<float>(i),
+                    .y = static_cast<float>(tick),
+                });
+            }
+
+            auto start = Clock::now();
+            if (onPool) {
+                channel.deliver(pool);
+            } else {
+                channel.deliver();
+            }
+            deliverTime += Clock::now() - start;
+        }
+        report("handler calls", eventCount * groupCount * ticks, deliverTime);
+
+        if (!onPool) {
+            serialSums = sums;
+        } else if (!std::ranges::equal(
+                       sums, serialSums, {}, &Sum::value, &Sum::value)) {
+            std::cout << "  (pool delivery saw different events)\n";
+        }
+    }
+}
+
+// Stand-ins for the AI actions in ai.cpp: every decision starts a nested
+// task, whose frame should come from the frame pool once it is warm.
+CoroTask step([[maybe_unused]] std::string_view name, int& position, int target)
+{
+    while (position != target) {
+        position += position < target ? 1 : -1;
+        co_await NextTick{};
+    }
+}
+
+CoroTask wander([[maybe_unused]] std::string_view name, int& position)
+{
+    for (int i = 0; i < 3; i++) {
+        co_await step("step", position, (position * 7 + 3) % 11 - 5);
+    }
+}
+
+CoroTask brain([[maybe_unused]] std::string_view name, int& position)
+{
+    for (;;) {
+        co_await wander("wander", position);
+    }
+}
+
+// Resumes brainCount brains every tick, and checks that past warm-up their
+// decisions no longer allocate.
+void benchmarkBrains(size_t brainCount)
+{
+    static constexpr int warmUpTicks = 50;
+    static constexpr int ticks = 200;
+
+    auto positions = std::vector<int>(brainCount);
+    auto brains = std::vector<CoroTask>{};
+    brains.reserve(brainCount);
+    for (auto& position : positions) {
+        brains.push_back(brain("brain", position));
+    }
+
+    for (int tick = 0; tick < warmUpTicks; tick++) {
+        for (auto& brain : brains) {
+            brain.resume();
+        }
+    }
+
+    auto before = framePoolStats();
+    auto start = Clock::now();
+    for (int tick = 0; tick < ticks; tick++) {
+        for (auto& brain : brains) {
+            brain.resume();
+        }
+    }
+    auto time = Clock::now() - start;
+    auto after = framePoolStats();
+
+    report("resume", brainCount * ticks, time);
+    auto frames = after.allocations - before.allocations;
+    auto heapAllocations = after.heapAllocations - before.heapAllocations;
+    std::cout << "  frames: " << frames << ", from the heap: "
+              << heapAllocations << "\n";
+    if (heapAllocations > 0) {
+        std::cout << "  (frames allocated from the heap after warm-up)\n";
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    auto entityCount = size_t{100'000};
+    if (argc > 1) {
+        entityCount = std::strtoull(argv[1], nullptr, 10);
+    }
+
+    auto order = std::vector<Entity>{};
+    order.reserve(entityCount);
+    for (size_t i = 0; i < entityCount; i++) {
+        order.emplace_back(static_cast<Entity::ValueType>(i));
+    }
+    std::ranges::shuffle(order, std::mt19937{42});
+
+    std::cout << entityCount << " entities, random access order\n";
+    benchmarkStorage<MapIndexedStorage<Payload>>("std::map index", order);
+    benchmarkStorage<ComponentStorage<Payload>>("sparse set index", order);
+    benchmarkStorage<ComponentStorage<StablePayload>, StablePayload>(
+        "stable sparse set index", order);
+
+    benchmarkEcs<SparseSetEcs>("SparseSetEcs", order);
+    benchmarkEcs<ArchetypeEcs>("ArchetypeEcs", order);
+
+    static constexpr size_t stressEntityCount = 1'000'000;
+    std::cout << stressEntityCount << " entities, 50% despawned per tick\n";
+    benchmarkMassDespawn<SparseSetEcs>("SparseSetEcs", stressEntityCount);
+    benchmarkMassDespawn<ArchetypeEcs>("ArchetypeEcs", stressEntityCount);
+
+    std::cout << entityCount << " entities respawned per tick via commands\n";
+    benchmarkCommands<SparseSetEcs>("SparseSetEcs", entityCount);
+    benchmarkCommands<ArchetypeEcs>("ArchetypeEcs", entityCount);
+
+    std::cout << entityCount << " events per tick, 8 handler groups\n";
+    benchmarkChannel(entityCount);
+
+    std::cout << entityCount << " coroutine brains\n";
+    benchmarkBrains(entityCount);
+
+    return EXIT_SUCCESS;
+}
@@ -2,14 +2,13 @@
 
 #include "events.hpp"
 #include "random.hpp"
+#include "trace.hpp"
 #include "world.hpp"
 
 #include <chrono>
 #include <tuple>
 #include <utility>
 
-#include <iostream>
-
 namespace {
 
 WorldPosition randomPointInSquare(const WorldPosition& center, float offset)
@@ -19,13 +18,23 @@ WorldPosition randomPointInSquare(const WorldPosition& center, float offset)
     return center + WorldVector{dx, dy};
 }
 
+// How long moving straight towards the point at full speed takes to get
+// within the distance of it.
+float arrivalTime(
+    const SimpleMovementComponent& mov,
+    const WorldPosition& point,
+    float proximity)
+{
+    return (distance(mov.position, point) - proximity) / mov.maxSpeed;
+}
+
 } // namespace
 
 CoroTask backAwayFrom(
-    std::string name, SimpleMovementComponent& mov, const WorldPosition& point)
+    std::string_view name,
+    SimpleMovementComponent& mov,
+    const WorldPosition& point)
 {
-    std::cerr << "backAwayFrom: start\n";
-
     static constexpr float backAwayDistance = 10.f;
     static constexpr float proximity = 0.3f;
 
@@ -34,104 +43,89 @@ CoroTask backAwayFrom(
     while (distance(mov.position, targetPoint) < proximity) {
         auto movement = (targetPoint - mov.position).norm();
         mov.velocity = movement * mov.maxSpeed;
-        co_await std::suspend_always{};
+        co_await NextTick{.validFor = arrivalTime(mov, targetPoint, proximity)};
     }
-
-    std::cerr << "backAwayFrom: finish\n";
+    mov.velocity = {};
 }
 
-CoroTask hiss(std::string name, Entity entity)
+CoroTask hiss(std::string_view name, Entity entity)
 {
-    std::cerr << "hiss: start\n";
-
     using namespace std::chrono_literals;
 
     events.push(HissEvent{entity});
-    // co_await WaitFor{1s};
-
-    std::cerr << "hiss: finish\n";
-    co_return;
+    co_await WaitFor{1s};
 }
 
 CoroTask approach(
-    std::string name,
+    std::string_view name,
     SimpleMovementComponent& mov,
     const SmoothMovementComponent& hero,
     float targetDistance)
 {
-    std::cerr << "approach: start\n";
-
     while (distance(mov.position, hero.position) > targetDistance) {
         mov.velocity = (hero.position - mov.position).norm() * mov.maxSpeed;
-        co_await std::suspend_always{};
+        co_await NextTick{
+            .validFor = arrivalTime(mov, hero.position, targetDistance)};
     }
-
-    std::cerr << "approach: finish\n";
+    mov.velocity = {};
 }
 
 CoroTask jumpAttack(
-    std::string name, SimpleMovementComponent& mov, const WorldPosition& point)
+    std::string_view name,
+    SimpleMovementComponent& mov,
+    const WorldPosition& point)
 {
-    std::cerr << "jumpAttack: start\n";
-
     mov.verticalVelocity = 6.f;
     mov.velocity = (point - mov.position) / 1.5f;
-    while (mov.height > 0 || mov.verticalVelocity != 0) {
-        co_await std::suspend_always{};
-    }
-
-    std::cerr << "jumpAttack: finish\n";
+    co_await WaitUntil{[&mov] {
+        return mov.height <= 0 && mov.verticalVelocity == 0;
+    }};
 }
 
 CoroTask moveTo(
-    std::string name, SimpleMovementComponent& mov, const WorldPosition& point)
+    std::string_view name,
+    SimpleMovementComponent& mov,
+    const WorldPosition& point)
 {
-    std::cerr << "move to: " << point << "\n";
+    auto span = co_await CurrentSpan{};
+    trace<TraceLevel::Debug>(span, "distance", distance(mov.position, point));
 
     while (distance(mov.position, point) > 0.2) {
-        std::cerr << "current distance is: " << distance(mov.position, point)
-                  << "\n";
+        trace<TraceLevel::Verbose>(
+            span, "distance", distance(mov.position, point));
 
         mov.velocity = (point - mov.position).norm() * mov.maxSpeed;
-
-        std::cerr << "awaiting inside moveTo\n";
-        co_await std::suspend_always{};
-        std::cerr << "resumed inside moveTo\n";
+        co_await NextTick{.validFor = arrivalTime(mov, point, 0.2f)};
     }
-
-    std::cerr << "target point reached\n";
+    mov.velocity = {};
 }
 
 CoroTask fidgetAround(
-    std::string name,
+    std::string_view name,
     const WorldPosition& point,
     SimpleMovementComponent& movement)
 {
-    std::cerr << "fidget\n";
-
     for (int i = 0; i < 3; i++) {
         auto targetPoint = randomPointInSquare(point, 0.5f);
-        std::cerr << "moving to " << targetPoint << "\n";
         co_await moveTo("moveTo", movement, targetPoint);
     }
 }
 
-CoroTask think(std::string name, Ecs& ecs, Entity entity)
+CoroTask think(
+    std::string_view name,
+    Ecs& ecs,
+    Entity entity,
+    const SmoothMovementComponent& hero)
 {
-    std::cerr << "think: start\n";
-
-    // suspend at the beginning, to allow passing this function to AI component
-    // upon creation
-    co_await std::suspend_always{};
-
+    // Both components have stable storage, so the references stay valid for
+    // as long as the entity lives.
     auto& ai = ecs.component<AiComponent>(entity);
     auto& mov = ecs.component<SimpleMovementComponent>(entity);
 
-    const auto& hero = ecs.components<SmoothMovementComponent>().front();
-
     auto dist = std::uniform_int_distribution<int>{0, 1};
+    auto span = co_await CurrentSpan{};
 
-    for (;;) {
+    while (ecs.alive(entity)) {
         if (ai.fear > 50) {
             if (distance(mov.position, hero.position) < 10) {
                 co_await backAwayFrom("backAwayFrom", mov, hero.position);
@@ -143,20 +137,15 @@ CoroTask think(std::string name, Ecs& ecs, Entity entity)
                 co_await fidgetAround("fidget", ai.homePoint, mov);
             } else if (distance(mov.position, hero.position) > 3) {
                 auto action = dist(random().engine());
-                std::cerr << "action id: " << action << "\n";
+                trace<TraceLevel::Debug>(span, "action", action);
                 if (action == 0) {
-                    std::cerr << "think: start approach\n";
                     co_await approach("approach", mov, hero, 3);
                 } else if (action == 1) {
-                    std::cerr << "think: start fidget\n";
                     co_await fidgetAround("fidget", mov.position, mov);
                 }
             } else {
-                std::cerr << "think: start jump attack\n";
                 co_await jumpAttack("jumpAttack", mov, hero.position);
             }
         }
     }
-
-    std::cerr << "think: finish\n";
 }
@@ -3,4 +3,14 @@
 #include "ecs.hpp"
 #include "task.hpp"
 
-CoroTask think(std::string name, Ecs& ecs, Entity entity);
+#include <string_view>
+
+struct SmoothMovementComponent;
+
+// The hero is passed by reference to a snapshot that stays put while brains
+// run, so that brains can run concurrently with anything moving the hero.
+CoroTask think(
+    std::string_view name,
+    Ecs& ecs,
+    Entity entity,
+    const SmoothMovementComponent& hero);
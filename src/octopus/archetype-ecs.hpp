@@ -0,0 +1,757 @@
+#pragma once
+
+#include "commands.hpp"
+#include "component-id.hpp"
+#include "entity.hpp"
+#include "stable-storage.hpp"
+#include "tick.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <limits>
+#include <map>
+#include <memory>
+#include <new>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Type-erased operations needed to shuffle components of an arbitrary type
+// between archetype chunks.
+struct ComponentInfo {
+    ComponentId id = 0;
+    size_t size = 0;
+    size_t alignment = 0;
+    // Move-constructs the object at target from source and destroys source.
+    void (*relocate)(void* target, void* source) = nullptr;
+    // The pool is the component type's stable pool, or null.
+    void (*destroy)(void* object, void* pool) = nullptr;
+    // Set for components with stable storage only. Each ECS makes one pool per
+    // such type.
+    std::shared_ptr<void> (*makePool)() = nullptr;
+};
+
+// What an archetype column holds for a component type. Rows move between
+// chunks and archetypes, so components with stable storage live in a paged
+// pool and only a pointer to them is kept in the column.
+template <class Component>
+using ColumnType =
+    std::conditional_t<stableStorage<Component>, Component*, Component>;
+
+template <class Component>
+Component& fromColumn(ColumnType<Component>& stored)
+{
+    if constexpr (stableStorage<Component>) {
+        return *stored;
+    } else {
+        return stored;
+    }
+}
+
+template <class Component, class... Args>
+Component& constructInColumn(void* target, void* pool, Args&&... args)
+{
+    if constexpr (stableStorage<Component>) {
+        auto* component = static_cast<PagedPool<Component>*>(pool)->create(
+            std::forward<Args>(args)...);
+        new (target) Component*(component);
+        return *component;
+    } else {
+        return *new (target) Component(std::forward<Args>(args)...);
+    }
+}
+
+template <class Component>
+std::shared_ptr<void> makeStablePool()
+{
+    return std::make_shared<PagedPool<Component>>();
+}
+
+template <class Component>
+const ComponentInfo& componentInfo()
+{
+    using Stored = ColumnType<Component>;
+    static const auto info = ComponentInfo{
+        .id = componentId<Component>(),
+        .size = sizeof(Stored),
+        .alignment = alignof(Stored),
+        .relocate =
+            [](void* target, void* source) {
+                auto* object = static_cast<Stored*>(source);
+                new (target) Stored(std::move(*object));
+                object->~Stored();
+            },
+        .destroy =
+            [](void* object, void* pool) {
+                if constexpr (stableStorage<Component>) {
+                    static_cast<PagedPool<Component>*>(pool)->destroy(
+                        *static_cast<Component**>(object));
+                } else {
+                    static_cast<Component*>(object)->~Component();
+                }
+            },
+        .makePool =
+            stableStorage<Component> ? &makeStablePool<Component> : nullptr,
+    };
+    return info;
+}
+
+// Stores all entities that have exactly the same set of component types.
+// Rows are kept dense across fixed-size chunks, and every chunk lays out the
+// entity column, one column per component type and one tick column per
+// component type back to back, so walking a column is a linear scan over
+// contiguous memory.
+class Archetype {
+public:
+    static constexpr size_t ChunkBytes = 16 * 1024;
+    static constexpr size_t ColumnAlignment = 64;
+    static constexpr size_t npos = std::numeric_limits<size_t>::max();
+
+    // Pools go with the components, see ComponentInfo::destroy.
+    Archetype(
+        std::vector<const ComponentInfo*> components,
+        std::vector<void*> pools)
+        : _components(std::move(components))
+        , _pools(std::move(pools))
+    {
+        _chunkAlignment = ColumnAlignment;
+        auto rowBytes = sizeof(Entity);
+        for (const auto* info : _components) {
+            _chunkAlignment = std::max(_chunkAlignment, info->alignment);
+            rowBytes += info->size + sizeof(Tick);
+        }
+
+        _chunkCapacity = std::max<size_t>(1, ChunkBytes / rowBytes);
+        while (_chunkCapacity > 1 && layout(_chunkCapacity) > ChunkBytes) {
+            _chunkCapacity--;
+        }
+        _chunkBytes = std::max(ChunkBytes, layout(_chunkCapacity));
+    }
+
+    Archetype(const Archetype&) = delete;
+    Archetype(Archetype&&) = delete;
+    Archetype& operator=(const Archetype&) = delete;
+    Archetype& operator=(Archetype&&) = delete;
+
+    ~Archetype()
+    {
+        for (size_t row = 0; row < _size; row++) {
+            for (size_t column = 0; column < _components.size(); column++) {
+                _components[column]->destroy(
+                    at(column, row), _pools[column]);
+            }
+        }
+    }
+
+    [[nodiscard]] const std::vector<const ComponentInfo*>& components() const
+    {
+        return _components;
+    }
+
+    [[nodiscard]] size_t findColumn(ComponentId id) const
+    {
+        for (size_t column = 0; column < _components.size(); column++) {
+            if (_components[column]->id == id) {
+                return column;
+            }
+        }
+        return npos;
+    }
+
+    [[nodiscard]] size_t size() const
+    {
+        return _size;
+    }
+
+    [[nodiscard]] void* pool(size_t column) const
+    {
+        return _pools[column];
+    }
+
+    [[nodiscard]] size_t chunkCapacity() const
+    {
+        return _chunkCapacity;
+    }
+
+    [[nodiscard]] size_t chunkCount() const
+    {
+        return _chunks.size();
+    }
+
+    [[nodiscard]] size_t rowsInChunk(size_t chunk) const
+    {
+        auto firstRow = chunk * _chunkCapacity;
+        return firstRow < _size ? std::min(_chunkCapacity, _size - firstRow)
+                                : 0;
+    }
+
+    Entity* entities(size_t chunk)
+    {
+        return reinterpret_cast<Entity*>(_chunks[chunk].get());
+    }
+
+    void* column(size_t chunk, size_t column)
+    {
+        return _chunks[chunk].get() + _offsets[column];
+    }
+
+    void* at(size_t column, size_t row)
+    {
+        return static_cast<std::byte*>(
+                   this->column(row / _chunkCapacity, column)) +
+            (row % _chunkCapacity) * _components[column]->size;
+    }
+
+    Tick* ticks(size_t chunk, size_t column)
+    {
+        return reinterpret_cast<Tick*>(
+            _chunks[chunk].get() + _tickOffsets[column]);
+    }
+
+    Tick& tick(size_t column, size_t row)
+    {
+        return ticks(row / _chunkCapacity, column)[row % _chunkCapacity];
+    }
+
+    Entity& entity(size_t row)
+    {
+        return entities(row / _chunkCapacity)[row % _chunkCapacity];
+    }
+
+    // Appends a row for the entity. The caller is responsible for constructing
+    // every component in the new row.
+    size_t pushRow(Entity entity)
+    {
+        auto row = _size;
+        if (row == _chunks.size() * _chunkCapacity) {
+            _chunks.push_back(allocateChunk());
+        }
+        _size++;
+        new (&this->entity(row)) Entity{entity};
+        return row;
+    }
+
+    // Destroys the components of a row and fills the hole with the last row.
+    // Returns the entity that was moved into the row, if any.
+    std::optional<Entity> removeRow(size_t row)
+    {
+        for (size_t column = 0; column < _components.size(); column++) {
+            _components[column]->destroy(at(column, row), _pools[column]);
+        }
+        return fillHole(row);
+    }
+
+    // Relocates the components of a row into an already pushed row of another
+    // archetype, destroying those the target does not have. Returns the entity
+    // that was moved into the vacated row, if any.
+    std::optional<Entity>
+    moveRow(size_t row, Archetype& target, size_t targetRow)
+    {
+        for (size_t column = 0; column < _components.size(); column++) {
+            const auto* info = _components[column];
+            auto targetColumn = target.findColumn(info->id);
+            if (targetColumn == npos) {
+                info->destroy(at(column, row), _pools[column]);
+            } else {
+                info->relocate(
+                    target.at(targetColumn, targetRow), at(column, row));
+                target.tick(targetColumn, targetRow) = tick(column, row);
+            }
+        }
+        return fillHole(row);
+    }
+
+    [[nodiscard]] Archetype* addEdge(ComponentId id) const
+    {
+        for (const auto& [edgeId, archetype] : _addEdges) {
+            if (edgeId == id) {
+                return archetype;
+            }
+        }
+        return nullptr;
+    }
+
+    void addEdge(ComponentId id, Archetype* archetype)
+    {
+        _addEdges.emplace_back(id, archetype);
+    }
+
+private:
+    struct ChunkDeleter {
+        std::align_val_t alignment;
+
+        void operator()(std::byte* ptr) const
+        {
+            ::operator delete(ptr, alignment);
+        }
+    };
+
+    using Chunk = std::unique_ptr<std::byte, ChunkDeleter>;
+
+    static size_t alignUp(size_t offset, size_t alignment)
+    {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    size_t layout(size_t capacity)
+    {
+        _offsets.clear();
+        _tickOffsets.clear();
+        auto offset = capacity * sizeof(Entity);
+        for (const auto* info : _components) {
+            offset =
+                alignUp(offset, std::max(ColumnAlignment, info->alignment));
+            _offsets.push_back(offset);
+            offset += capacity * info->size;
+        }
+        for (size_t column = 0; column < _components.size(); column++) {
+            offset = alignUp(offset, ColumnAlignment);
+            _tickOffsets.push_back(offset);
+            offset += capacity * sizeof(Tick);
+        }
+        return offset;
+    }
+
+    Chunk allocateChunk() const
+    {
+        auto alignment = std::align_val_t{_chunkAlignment};
+        return Chunk{
+            static_cast<std::byte*>(::operator new(_chunkBytes, alignment)),
+            ChunkDeleter{alignment}};
+    }
+
+    std::optional<Entity> fillHole(size_t row)
+    {
+        auto lastRow = _size - 1;
+        auto moved = std::optional<Entity>{};
+        if (row != lastRow) {
+            for (size_t column = 0; column < _components.size(); column++) {
+                _components[column]->relocate(
+                    at(column, row), at(column, lastRow));
+                tick(column, row) = tick(column, lastRow);
+            }
+            entity(row) = entity(lastRow);
+            moved = entity(row);
+        }
+        _size--;
+
+        // Keep one spare chunk around, so an entity oscillating on a chunk
+        // boundary does not allocate every time.
+        if (_chunks.size() * _chunkCapacity >= _size + 2 * _chunkCapacity) {
+            _chunks.pop_back();
+        }
+        return moved;
+    }
+
+    std::vector<const ComponentInfo*> _components;
+    std::vector<void*> _pools;
+    std::vector<size_t> _offsets;
+    std::vector<size_t> _tickOffsets;
+    size_t _chunkAlignment = ColumnAlignment;
+    size_t _chunkCapacity = 0;
+    size_t _chunkBytes = 0;
+    std::vector<Chunk> _chunks;
+    size_t _size = 0;
+    std::vector<std::pair<ComponentId, Archetype*>> _addEdges;
+};
+
+// Iterates every archetype that contains all of the given components, chunk
+// by chunk, yielding (entity, components...) tuples. Rows are numbered
+// consecutively across the matching archetypes, so a view can be sliced into
+// ranges for parallel processing.
+template <class... Components>
+class ArchetypeView {
+public:
+    using Value = std::tuple<Entity, Components&...>;
+
+    struct Match {
+        Archetype* archetype = nullptr;
+        std::array<size_t, sizeof...(Components)> columns{};
+    };
+
+    explicit ArchetypeView(std::vector<Match> matches)
+        : _matches(std::move(matches))
+    {
+        for (const auto& match : _matches) {
+            _end += match.archetype->size();
+        }
+    }
+
+    class Iterator {
+    public:
+        Iterator(const ArchetypeView* view, size_t position)
+            : _view(view)
+            , _position(position)
+        {
+            if (_position >= _view->_end) {
+                return;
+            }
+
+            auto row = _position;
+            while (row >= _view->_matches[_match].archetype->size()) {
+                row -= _view->_matches[_match].archetype->size();
+                _match++;
+            }
+            const auto* archetype = _view->_matches[_match].archetype;
+            _chunk = row / archetype->chunkCapacity();
+            _row = row % archetype->chunkCapacity();
+            enterChunk();
+        }
+
+        Value operator*() const
+        {
+            return std::apply(
+                [this](ColumnType<Components>*... columns) {
+                    return Value{
+                        _entities[_row],
+                        fromColumn<Components>(columns[_row])...};
+                },
+                _columns);
+        }
+
+        Iterator& operator++()
+        {
+            if (++_position < _view->_end && ++_row == _rows) {
+                _row = 0;
+                _chunk++;
+                enterChunk();
+            }
+            return *this;
+        }
+
+        bool operator==(const Iterator& other) const
+        {
+            return _position == other._position;
+        }
+
+    private:
+        void enterChunk()
+        {
+            for (; _match < _view->_matches.size(); _match++, _chunk = 0) {
+                const auto& match = _view->_matches[_match];
+                for (; _chunk < match.archetype->chunkCount(); _chunk++) {
+                    _rows = match.archetype->rowsInChunk(_chunk);
+                    if (_rows > 0) {
+                        _entities = match.archetype->entities(_chunk);
+                        loadColumns(
+                            match, std::index_sequence_for<Components...>{});
+                        return;
+                    }
+                }
+            }
+        }
+
+        template <size_t... I>
+        void loadColumns(const Match& match, std::index_sequence<I...>)
+        {
+            _columns = std::tuple<ColumnType<Components>*...>{
+                static_cast<ColumnType<Components>*>(
+                    match.archetype->column(_chunk, match.columns[I]))...};
+        }
+
+        const ArchetypeView* _view = nullptr;
+        size_t _position = 0;
+        size_t _match = 0;
+        size_t _chunk = 0;
+        size_t _row = 0;
+        size_t _rows = 0;
+        Entity* _entities = nullptr;
+        std::tuple<ColumnType<Components>*...> _columns;
+    };
+
+    Iterator begin() const
+    {
+        return Iterator{this, _begin};
+    }
+
+    Iterator end() const
+    {
+        return Iterator{this, _end};
+    }
+
+    [[nodiscard]] size_t size() const
+    {
+        return _end - _begin;
+    }
+
+    [[nodiscard]] ArchetypeView slice(size_t begin, size_t end) const
+    {
+        auto view = *this;
+        view._begin = _begin + begin;
+        view._end = _begin + end;
+        return view;
+    }
+
+private:
+    std::vector<Match> _matches;
+    size_t _begin = 0;
+    size_t _end = 0;
+};
+
+// An alternative to SparseSetEcs that groups entities by their component set.
+// Iterating several components at once touches only archetypes that have all
+// of them, and killing an entity removes a single row without consulting a
+// per-entity list of component types.
+class ArchetypeEcs {
+public:
+    template <class Component>
+    Component& component(Entity entity)
+    {
+        const auto& record = existingRecord(entity);
+        auto column = record.archetype
+            ? record.archetype->findColumn(componentId<Component>())
+            : Archetype::npos;
+        if (column == Archetype::npos) {
+            throw std::out_of_range{"ArchetypeEcs: entity has no component"};
+        }
+        return fromColumn<Component>(*static_cast<ColumnType<Component>*>(
+            record.archetype->at(column, record.row)));
+    }
+
+    template <class Component>
+    const Component& component(Entity entity) const
+    {
+        return const_cast<ArchetypeEcs*>(this)->component<Component>(entity);
+    }
+
+    template <class... Components>
+    ArchetypeView<Components...> view()
+    {
+        using Match = typename ArchetypeView<Components...>::Match;
+
+        auto matches = std::vector<Match>{};
+        for (const auto& archetype : _archetypes) {
+            auto match = Match{
+                .archetype = archetype.get(),
+                .columns =
+                    {archetype->findColumn(componentId<Components>())...},
+            };
+            if (std::ranges::find(match.columns, Archetype::npos) ==
+                match.columns.end()) {
+                matches.push_back(match);
+            }
+        }
+        return ArchetypeView<Components...>{std::move(matches)};
+    }
+
+    template <class Component>
+    std::remove_cvref_t<Component>& add(Entity entity, Component&& component)
+    {
+        return emplace<std::remove_cvref_t<Component>>(
+            entity, std::forward<Component>(component));
+    }
+
+    template <class Component, class... Args>
+    Component& emplace(Entity entity, Args&&... args)
+    {
+        auto id = componentId<Component>();
+        auto& record = existingRecord(entity);
+        auto* source = record.archetype;
+        if (source && source->findColumn(id) != Archetype::npos) {
+            throw std::logic_error{"ArchetypeEcs: component already added"};
+        }
+
+        auto& target = archetypeWith(source, componentInfo<Component>());
+        auto targetRow = target.pushRow(entity);
+        auto targetColumn = target.findColumn(id);
+        auto& component = constructInColumn<Component>(
+            target.at(targetColumn, targetRow),
+            target.pool(targetColumn),
+            std::forward<Args>(args)...);
+        target.tick(targetColumn, targetRow) = _tick;
+
+        if (source) {
+            if (auto moved = source->moveRow(record.row, target, targetRow)) {
+                _records[moved->index()].row = record.row;
+            }
+        }
+        record = Record{.archetype = &target, .row = targetRow};
+        return component;
+    }
+
+    // The tick currently being simulated. Every flush() starts a new one.
+    [[nodiscard]] Tick tick() const
+    {
+        return _tick;
+    }
+
+    // Records that a system modified the entity's component. Adding a
+    // component counts as a change too.
+    template <class Component>
+    void markChanged(Entity entity)
+    {
+        const auto& record = existingRecord(entity);
+        auto column = record.archetype
+            ? record.archetype->findColumn(componentId<Component>())
+            : Archetype::npos;
+        if (column == Archetype::npos) {
+            throw std::out_of_range{"ArchetypeEcs: entity has no component"};
+        }
+        record.archetype->tick(column, record.row) = _tick;
+    }
+
+    // Calls function(entity, component) for every component of the type that
+    // changed in or after the given tick.
+    template <class Component, class Function>
+    void eachChanged(Tick since, Function&& function)
+    {
+        for (const auto& archetype : _archetypes) {
+            auto column = archetype->findColumn(componentId<Component>());
+            if (column == Archetype::npos) {
+                continue;
+            }
+            for (size_t chunk = 0; chunk < archetype->chunkCount(); chunk++) {
+                auto* entities = archetype->entities(chunk);
+                auto* components = static_cast<ColumnType<Component>*>(
+                    archetype->column(chunk, column));
+                auto* ticks = archetype->ticks(chunk, column);
+                auto rows = archetype->rowsInChunk(chunk);
+                for (size_t row = 0; row < rows; row++) {
+                    if (ticks[row] >= since) {
+                        function(
+                            entities[row],
+                            fromColumn<Component>(components[row]));
+                    }
+                }
+            }
+        }
+    }
+
+    Entity create()
+    {
+        auto entity = _entityPool.create();
+        _records.resize(_entityPool.size());
+        _records[entity.index()] = Record{};
+        return entity;
+    }
+
+    Entity reserve()
+    {
+        return _entityPool.reserve();
+    }
+
+    [[nodiscard]] bool alive(Entity entity) const
+    {
+        return _entityPool.alive(entity);
+    }
+
+    void kill(Entity entity)
+    {
+        auto& record = existingRecord(entity);
+        if (record.archetype) {
+            if (auto moved = record.archetype->removeRow(record.row)) {
+                _records[moved->index()].row = record.row;
+            }
+        }
+        record = Record{};
+        _entityPool.kill(entity);
+    }
+
+    // Kills every live entity in the list; dead or repeated handles are
+    // skipped.
+    void killMany(std::span<const Entity> entities)
+    {
+        for (auto entity : entities) {
+            if (_entityPool.alive(entity)) {
+                kill(entity);
+            }
+        }
+    }
+
+    // The calling thread's command buffer. Recorded changes are applied by
+    // flush(), which must not overlap with any system.
+    CommandBuffer<ArchetypeEcs>& commands()
+    {
+        return _commands.local(*this);
+    }
+
+    void flush()
+    {
+        _entityPool.commitReserved();
+        _records.resize(_entityPool.size());
+        _commands.apply(*this);
+        _tick++;
+    }
+
+private:
+    struct Record {
+        Archetype* archetype = nullptr;
+        size_t row = 0;
+    };
+
+    Record& existingRecord(Entity entity)
+    {
+        if (!_entityPool.alive(entity)) {
+            throw std::out_of_range{"ArchetypeEcs: entity is not alive"};
+        }
+        return _records[entity.index()];
+    }
+
+    Archetype& archetypeWith(Archetype* source, const ComponentInfo& info)
+    {
+        if (source) {
+            if (auto* cached = source->addEdge(info.id)) {
+                return *cached;
+            }
+        }
+
+        auto components = source ? source->components()
+                                 : std::vector<const ComponentInfo*>{};
+        components.push_back(&info);
+        std::ranges::sort(components, [](const auto* lhs, const auto* rhs) {
+            return lhs->id < rhs->id;
+        });
+
+        auto signature = std::vector<ComponentId>{};
+        for (const auto* component : components) {
+            signature.push_back(component->id);
+        }
+
+        auto [it, inserted] = _archetypeBySignature.emplace(signature, nullptr);
+        if (inserted) {
+            auto pools = std::vector<void*>{};
+            for (const auto* component : components) {
+                pools.push_back(stablePool(*component));
+            }
+            it->second = _archetypes
+                             .emplace_back(std::make_unique<Archetype>(
+                                 std::move(components), std::move(pools)))
+                             .get();
+        }
+
+        if (source) {
+            source->addEdge(info.id, it->second);
+        }
+        return *it->second;
+    }
+
+    // The pool of a component type with stable storage, shared by all
+    // archetypes with that type, so rows move between them by pointer.
+    void* stablePool(const ComponentInfo& info)
+    {
+        if (!info.makePool) {
+            return nullptr;
+        }
+        if (info.id >= _stablePools.size()) {
+            _stablePools.resize(info.id + 1);
+        }
+        if (!_stablePools[info.id]) {
+            _stablePools[info.id] = info.makePool();
+        }
+        return _stablePools[info.id].get();
+    }
+
+    EntityPool _entityPool;
+    std::vector<Record> _records;
+    // Declared before the archetypes, which return their components here.
+    std::vector<std::shared_ptr<void>> _stablePools;
+    std::vector<std::unique_ptr<Archetype>> _archetypes;
+    std::map<std::vector<ComponentId>, Archetype*> _archetypeBySignature;
+    CommandBuffers<ArchetypeEcs> _commands;
+    Tick _tick = 1;
+};
@@ -0,0 +1,99 @@
+#include "atlas.hpp"
+
+#include <algorithm>
+#include <format>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+// Keeps filtering from sampling the neighbouring image.
+constexpr int Padding = 1;
+
+struct Image {
+    std::string name;
+    sdl::Surface surface;
+    size_t page = 0;
+    SDL_Rect rect{};
+};
+
+} // namespace
+
+Atlas::Atlas(sdl::Renderer& renderer, const std::filesystem::path& directory)
+{
+    auto images = std::vector<Image>{};
+    for (const auto& entry : std::filesystem::directory_iterator{directory}) {
+        if (entry.path().extension() == ".png") {
+            images.push_back(Image{
+                .name = entry.path().stem().string(),
+                .surface = img::load(entry.path()),
+            });
+        }
+    }
+    std::ranges::sort(images, std::ranges::greater{}, [](const Image& image) {
+        return image.surface.size().h;
+    });
+
+    auto pageHeights = std::vector<int>{};
+    auto x = 0;
+    auto y = 0;
+    auto shelfHeight = 0;
+    for (auto& image : images) {
+        auto size = image.surface.size();
+        if (size.w > PageSize || size.h > PageSize) {
+            throw std::runtime_error{std::format(
+                "image {} is larger than an atlas page", image.name)};
+        }
+
+        if (x + size.w > PageSize) {
+            x = 0;
+            y += shelfHeight;
+            shelfHeight = 0;
+        }
+        if (pageHeights.empty() || y + size.h > PageSize) {
+            pageHeights.push_back(0);
+            x = 0;
+            y = 0;
+            shelfHeight = 0;
+        }
+
+        image.page = pageHeights.size() - 1;
+        image.rect = SDL_Rect{.x = x, .y = y, .w = size.w, .h = size.h};
+        pageHeights.back() = std::max(pageHeights.back(), y + size.h);
+        x += size.w + Padding;
+        shelfHeight = std::max(shelfHeight, size.h + Padding);
+    }
+
+    auto pages = std::vector<sdl::Surface>{};
+    for (auto height : pageHeights) {
+        pages.emplace_back(PageSize, height);
+    }
+    for (auto& image : images) {
+        pages[image.page].blit(image.surface, image.rect);
+    }
+
+    _pages.reserve(pages.size());
+    for (auto& page : pages) {
+        _pages.push_back(renderer.createTextureFromSurface(page));
+    }
+    for (const auto& image : images) {
+        _regions.emplace(
+            image.name,
+            AtlasRegion{.texture = &_pages[image.page], .rect = image.rect});
+    }
+}
+
+const AtlasRegion& Atlas::region(std::string_view name) const
+{
+    auto it = _regions.find(name);
+    if (it == _regions.end()) {
+        throw std::out_of_range{std::format("no atlas region {}", name)};
+    }
+    return it->second;
+}
+
+size_t Atlas::pageCount() const
+{
+    return _pages.size();
+}
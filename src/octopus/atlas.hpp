@@ -0,0 +1,38 @@
+#pragma once
+
+#include "sdl.hpp"
+
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct AtlasRegion {
+    sdl::Texture* texture = nullptr;
+    SDL_Rect rect{};
+};
+
+// Packs images into as few textures as possible, so that sprites sharing a
+// texture can be drawn in one batch. Images are placed on shelves, tallest
+// first; a new page is started when one fills up.
+class Atlas {
+public:
+    static constexpr int PageSize = 2048;
+
+    // Packs every PNG in the directory. Regions are named after file stems.
+    Atlas(sdl::Renderer& renderer, const std::filesystem::path& directory);
+
+    Atlas(const Atlas&) = delete;
+    Atlas(Atlas&&) = delete;
+    Atlas& operator=(const Atlas&) = delete;
+    Atlas& operator=(Atlas&&) = delete;
+
+    [[nodiscard]] const AtlasRegion& region(std::string_view name) const;
+    [[nodiscard]] size_t pageCount() const;
+
+private:
+    std::vector<sdl::Texture> _pages;
+    std::map<std::string, AtlasRegion, std::less<>> _regions;
+};
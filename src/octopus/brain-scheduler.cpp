@@ -0,0 +1,170 @@
+#include "brain-scheduler.hpp"
+
+#include "world.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <utility>
+
+void BrainScheduler::add(Entity entity)
+{
+    _ready.push_back(entity);
+}
+
+void BrainScheduler::budget(std::chrono::microseconds budget)
+{
+    _budget = budget;
+}
+
+void BrainScheduler::beginFrame()
+{
+    _frameDeadline = Clock::now() + _budget;
+}
+
+void BrainScheduler::lod(std::vector<ThinkLod> levels)
+{
+    _lod = std::move(levels);
+    std::ranges::sort(_lod, {}, &ThinkLod::distance);
+}
+
+void BrainScheduler::update(
+    Ecs& ecs, ThreadPool& pool, float delta, const WorldPosition& focus)
+{
+    _time += delta;
+
+    while (!_sleepers.empty() && _sleepers.front().wakeTime <= _time) {
+        std::ranges::pop_heap(
+            _sleepers, std::ranges::greater{}, &Sleeper::wakeTime);
+        _ready.push_back(_sleepers.back().entity);
+        _sleepers.pop_back();
+    }
+
+    std::erase_if(_polling, [this, &ecs](Entity entity) {
+        if (!ecs.alive(entity)) {
+            return true;
+        }
+        const auto& wait = ecs.component<AiComponent>(entity).brain.wait();
+        if (wait.condition->ready()) {
+            _ready.push_back(entity);
+            return true;
+        }
+        return false;
+    });
+
+    // Left-overs from the previous update go first.
+    _resuming.swap(_backlog);
+    _resuming.insert(_resuming.end(), _ready.begin(), _ready.end());
+    _ready.clear();
+    _backlog.clear();
+
+    // Every thread of the pool takes batches of brains through a shared
+    // cursor, in order, so the left-overs at the front always start first.
+    // Each brain only records what it waits for next, and the queues are
+    // updated afterwards on this thread.
+    auto deadline = _frameDeadline.value_or(Clock::now() + _budget);
+    _resumptions.assign(_resuming.size(), Resumption{});
+    auto cursor = std::atomic<size_t>{0};
+    auto batchCount =
+        (_resuming.size() + ResumeBatchSize - 1) / ResumeBatchSize;
+    auto runnerCount = std::min(pool.workerCount() + 1, batchCount);
+    pool.parallelFor(runnerCount, 1, [&](size_t, size_t) {
+        for (;;) {
+            auto begin = cursor.fetch_add(ResumeBatchSize);
+            if (begin >= _resuming.size()) {
+                return;
+            }
+            auto end = std::min(begin + ResumeBatchSize, _resuming.size());
+            for (auto i = begin; i < end; i++) {
+                // The budget is checked before every brain, and at least one
+                // runs per update, however small the budget.
+                if (_budget.count() > 0 && i > 0 && Clock::now() >= deadline) {
+                    return;
+                }
+                _resumptions[i] = resume(ecs, _resuming[i], focus);
+            }
+        }
+    });
+
+    for (size_t i = 0; i < _resuming.size(); i++) {
+        auto entity = _resuming[i];
+        const auto& resumption = _resumptions[i];
+        switch (resumption.outcome) {
+            case Outcome::Deferred: _backlog.push_back(entity); break;
+            case Outcome::Finished: break;
+            case Outcome::NextTick: _ready.push_back(entity); break;
+            case Outcome::Sleep: sleep(entity, resumption.seconds); break;
+            case Outcome::Poll: _polling.push_back(entity); break;
+        }
+    }
+    _resuming.clear();
+}
+
+float BrainScheduler::now() const
+{
+    return _time;
+}
+
+size_t BrainScheduler::backlog() const
+{
+    return _backlog.size();
+}
+
+BrainScheduler::Resumption BrainScheduler::resume(
+    Ecs& ecs, Entity entity, const WorldPosition& focus) const
+{
+    if (!ecs.alive(entity)) {
+        return Resumption{.outcome = Outcome::Finished};
+    }
+
+    auto& brain = ecs.component<AiComponent>(entity).brain;
+    brain.resume();
+    if (brain.done()) {
+        return Resumption{.outcome = Outcome::Finished};
+    }
+
+    const auto& wait = brain.wait();
+    switch (wait.kind) {
+        case WaitState::Kind::NextTick: {
+            auto interval = 0.f;
+            if (!_lod.empty()) {
+                const auto& position =
+                    ecs.component<SimpleMovementComponent>(entity).position;
+                interval = thinkInterval(distance(position, focus));
+            }
+            // Skipping ticks must not carry the brain past what it is heading
+            // for.
+            interval = std::min(interval, wait.seconds);
+            if (interval > 0.f) {
+                return Resumption{
+                    .outcome = Outcome::Sleep, .seconds = interval};
+            }
+            return Resumption{.outcome = Outcome::NextTick};
+        }
+        case WaitState::Kind::Duration:
+            return Resumption{
+                .outcome = Outcome::Sleep, .seconds = wait.seconds};
+        case WaitState::Kind::Condition:
+            return Resumption{.outcome = Outcome::Poll};
+    }
+    return Resumption{.outcome = Outcome::NextTick};
+}
+
+void BrainScheduler::sleep(Entity entity, float seconds)
+{
+    _sleepers.push_back(Sleeper{.wakeTime = _time + seconds, .entity = entity});
+    std::ranges::push_heap(
+        _sleepers, std::ranges::greater{}, &Sleeper::wakeTime);
+}
+
+float BrainScheduler::thinkInterval(float distance) const
+{
+    auto interval = 0.f;
+    for (const auto& level : _lod) {
+        if (distance < level.distance) {
+            break;
+        }
+        interval = level.interval;
+    }
+    return interval;
+}
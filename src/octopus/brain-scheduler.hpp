@@ -0,0 +1,93 @@
+#pragma once
+
+#include "ecs.hpp"
+#include "geometry.hpp"
+#include "thread-pool.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+// Beyond this distance from the focus point, a brain asking for the next
+// tick is resumed only once per interval.
+struct ThinkLod {
+    float distance = 0.f;
+    float interval = 0.f;
+};
+
+// Resumes AI brains only when they are due. Brains that wait for a duration
+// sit in a min-heap keyed by wake-up time, brains that wait for a condition
+// are polled without being resumed, and only the rest run every tick. Brains
+// of dead entities are dropped the next time they come up.
+//
+// Resuming stops once the frame's budget is spent; brains left over are
+// resumed first on the next update, so all of them get their turn. A frame
+// may span several updates, which then share one budget.
+//
+// Brains are resumed in parallel on a thread pool. A brain may only write to
+// its own entity's components, read shared state that stays constant during
+// the update (such as a hero snapshot), and push events.
+class BrainScheduler {
+public:
+    // Starts resuming the entity's AiComponent brain on the next tick.
+    void add(Entity entity);
+
+    // Zero means no limit.
+    void budget(std::chrono::microseconds budget);
+
+    // Starts the budget of a frame, shared by the updates until the next
+    // call. Without it, every update gets a budget of its own.
+    void beginFrame();
+
+    // Brains that use levels of detail need a SimpleMovementComponent.
+    void lod(std::vector<ThinkLod> levels);
+
+    void update(
+        Ecs& ecs, ThreadPool& pool, float delta, const WorldPosition& focus);
+
+    [[nodiscard]] float now() const;
+
+    // Brains that were due but did not fit into the last update's budget.
+    [[nodiscard]] size_t backlog() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t ResumeBatchSize = 64;
+
+    struct Sleeper {
+        float wakeTime = 0.f;
+        Entity entity;
+    };
+
+    enum class Outcome {
+        // Not resumed for lack of budget.
+        Deferred,
+        Finished,
+        NextTick,
+        Sleep,
+        Poll,
+    };
+
+    struct Resumption {
+        Outcome outcome = Outcome::Deferred;
+        float seconds = 0.f;
+    };
+
+    [[nodiscard]] Resumption resume(
+        Ecs& ecs, Entity entity, const WorldPosition& focus) const;
+    void sleep(Entity entity, float seconds);
+    [[nodiscard]] float thinkInterval(float distance) const;
+
+    float _time = 0.f;
+    std::chrono::microseconds _budget{0};
+    std::optional<Clock::time_point> _frameDeadline;
+    std::vector<ThinkLod> _lod;
+    std::vector<Entity> _ready;
+    std::vector<Entity> _resuming;
+    std::vector<Resumption> _resumptions;
+    std::vector<Entity> _backlog;
+    std::vector<Sleeper> _sleepers;
+    std::vector<Entity> _polling;
+};
@@ -1,11 +1,20 @@
 #pragma once
 
-#include <any>
+#include "sparse-index.hpp"
+#include "thread-pool.hpp"
+
+#include <algorithm>
+#include <atomic>
 #include <concepts>
-#include <functional>
-#include <map>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
 #include <memory>
-#include <typeindex>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -39,76 +48,710 @@ private:
     std::shared_ptr<char> _ptr = std::make_shared<char>();
 };
 
+using EventTypeId = uint32_t;
+
+inline EventTypeId nextEventTypeId()
+{
+    static auto next = std::atomic<EventTypeId>{0};
+    return next++;
+}
+
+// Dense per-type id, assigned on first use.
+template <class Event>
+EventTypeId eventTypeId()
+{
+    static const auto id = nextEventTypeId();
+    return id;
+}
+
+template <class Event>
+class EventHandler {
+public:
+    virtual ~EventHandler() = default;
+    virtual void operator()(const Event& event) = 0;
+};
+
+template <class Event, class Function>
+class FunctionEventHandler : public EventHandler<Event> {
+public:
+    explicit FunctionEventHandler(Function function)
+        : _function(std::move(function))
+    { }
+
+    void operator()(const Event& event) override
+    {
+        _function(event);
+    }
+
+private:
+    Function _function;
+};
+
+using HandlerGroupId = uint32_t;
+
+// Where the handlers of a group run when the channel delivers on a thread
+// pool.
+enum class HandlerAffinity {
+    // On the thread calling deliver(); required for anything touching SDL.
+    MainThread,
+    // On any pool thread, concurrently with other groups.
+    Pool,
+};
+
+struct HandlerGroup {
+    HandlerAffinity affinity = HandlerAffinity::Pool;
+    // Handlers of an ordered group run one after another, in event type and
+    // subscription order. Those of an unordered group may run concurrently
+    // with each other.
+    bool ordered = true;
+};
+
+// Delivery happens in three steps: every queue takes its pending events,
+// subscriptions hand them out (possibly from several threads at once), and
+// the queues drop them.
+class AbstractEventQueue {
+public:
+    virtual ~AbstractEventQueue() = default;
+
+    virtual void prepare() = 0;
+    [[nodiscard]] virtual int deliveryOrder() const = 0;
+    [[nodiscard]] virtual size_t subscriptionCount() const = 0;
+    [[nodiscard]] virtual HandlerGroupId group(size_t subscription) const = 0;
+    virtual void deliverTo(size_t subscription) = 0;
+    virtual void finish() = 0;
+};
+
+// What a queue does with an event pushed while it already holds
+// `capacity` events.
+enum class OverflowPolicy {
+    // Keep growing; capacity is only the initially reserved size.
+    Grow,
+    // Overwrite the oldest queued event, ring-buffer style.
+    DropOldest,
+    // Replace the queued event that has the same key, if there is one.
+    // Applies regardless of capacity.
+    Coalesce,
+};
+
+template <class Event>
+struct EventQueueConfig {
+    size_t capacity = 0;
+    OverflowPolicy overflow = OverflowPolicy::Grow;
+    uint64_t (*key)(const Event&) = nullptr;
+    // Keys are entity values, and are looked up by entity index in a paged
+    // array instead of a hash map. Events of different versions of an index
+    // never coalesce.
+    bool entityKeys = false;
+    // If set, events pushed from different threads are merged in order of
+    // this key instead of thread by thread, so the queue content does not
+    // depend on scheduling. Events with equal keys keep their per-thread
+    // order.
+    uint64_t (*order)(const Event&) = nullptr;
+    // Queues are delivered in ascending order of this, and queues that tie
+    // in the order their event types were first used. Lets handlers rely on
+    // events of one type having been handled before those of another.
+    int deliveryOrder = 0;
+};
+
+struct EventQueueStats {
+    size_t highWaterMark = 0;
+    size_t dropped = 0;
+    size_t coalesced = 0;
+};
+
+// Events of a single type, stored contiguously together with the
+// subscriptions to that type. The queue is double-buffered: delivery swaps
+// the buffers, so events pushed by handlers wait for the next delivery, and
+// both buffers keep their storage from frame to frame.
+template <class Event>
+class EventQueue : public AbstractEventQueue {
+public:
+    void configure(const EventQueueConfig<Event>& config)
+    {
+        if (config.overflow == OverflowPolicy::Coalesce && !config.key) {
+            throw std::invalid_argument{
+                "EventQueue: coalescing requires a key function"};
+        }
+        if (config.overflow == OverflowPolicy::DropOldest &&
+                config.capacity == 0) {
+            throw std::invalid_argument{
+                "EventQueue: dropping requires a capacity"};
+        }
+        normalize();
+        forgetSlots();
+        _config = config;
+        // Pushes only ever replace events once the queue is full, so a queue
+        // that is already past its new capacity loses its oldest events now.
+        if (_config.overflow == OverflowPolicy::DropOldest &&
+                _events.size() > _config.capacity) {
+            auto excess = _events.size() - _config.capacity;
+            _events.erase(
+                _events.begin(),
+                _events.begin() + static_cast<std::ptrdiff_t>(excess));
+            _stats.dropped += excess;
+        }
+        _events.reserve(config.capacity);
+        _delivering.reserve(config.capacity);
+        if (_config.overflow == OverflowPolicy::Coalesce) {
+            for (size_t i = 0; i < _events.size(); i++) {
+                rememberSlot(_config.key(_events[i]), i);
+            }
+        }
+    }
+
+    [[nodiscard]] const EventQueueConfig<Event>& config() const
+    {
+        return _config;
+    }
+
+    [[nodiscard]] const EventQueueStats& stats() const
+    {
+        return _stats;
+    }
+
+    template <class E>
+    void push(E&& event)
+    {
+        switch (_config.overflow) {
+            case OverflowPolicy::Grow:
+                break;
+            case OverflowPolicy::DropOldest:
+                if (_events.size() == _config.capacity) {
+                    _events[_head] = std::forward<E>(event);
+                    _head = (_head + 1) % _events.size();
+                    _stats.dropped++;
+                    return;
+                }
+                break;
+            case OverflowPolicy::Coalesce: {
+                auto key = _config.key(event);
+                if (auto slot = findSlot(key); slot < _events.size()) {
+                    _events[slot] = std::forward<E>(event);
+                    _stats.coalesced++;
+                    return;
+                }
+                rememberSlot(key, _events.size());
+                break;
+            }
+        }
+
+        _events.push_back(std::forward<E>(event));
+        _stats.highWaterMark = std::max(_stats.highWaterMark, _events.size());
+    }
+
+    template <class Handler>
+    void subscribe(
+        Handler&& handler,
+        const LifeHolder& lifeHolder,
+        HandlerGroupId group)
+    {
+        _subscriptions.push_back(Subscription{
+            .tracker = lifeHolder.tracker(),
+            .group = group,
+            .handler = std::make_unique<
+                FunctionEventHandler<Event, std::decay_t<Handler>>>(
+                std::forward<Handler>(handler)),
+        });
+    }
+
+    // Takes the queued events for delivery and drops dead subscriptions.
+    void prepare() override
+    {
+        normalize();
+        forgetSlots();
+        _delivering.clear();
+        std::swap(_events, _delivering);
+
+        std::erase_if(_subscriptions, [](const Subscription& subscription) {
+            return !subscription.tracker;
+        });
+    }
+
+    [[nodiscard]] int deliveryOrder() const override
+    {
+        return _config.deliveryOrder;
+    }
+
+    [[nodiscard]] size_t subscriptionCount() const override
+    {
+        return _subscriptions.size();
+    }
+
+    [[nodiscard]] HandlerGroupId group(size_t subscription) const override
+    {
+        return _subscriptions[subscription].group;
+    }
+
+    // Hands every taken event to one subscriber, in order. Different
+    // subscriptions may be delivered to concurrently.
+    void deliverTo(size_t subscription) override
+    {
+        auto& handler = *_subscriptions[subscription].handler;
+        for (const auto& event : _delivering) {
+            handler(event);
+        }
+    }
+
+    void finish() override
+    {
+        _delivering.clear();
+    }
+
+private:
+    struct Subscription {
+        LifeTracker tracker;
+        HandlerGroupId group = 0;
+        std::unique_ptr<EventHandler<Event>> handler;
+    };
+
+    // Puts the oldest event first after the ring buffer has wrapped.
+    void normalize()
+    {
+        if (_head != 0) {
+            std::ranges::rotate(_events, _events.begin() + _head);
+            _head = 0;
+        }
+    }
+
+    [[nodiscard]] size_t findSlot(uint64_t key) const
+    {
+        if (_config.entityKeys) {
+            auto slot = _slotByIndex.find(entityIndex(key));
+            if (slot == SparseIndex::npos ||
+                    _config.key(_events[slot]) != key) {
+                return _events.size();
+            }
+            return slot;
+        }
+        auto it = _slotByKey.find(key);
+        return it == _slotByKey.end() ? _events.size() : it->second;
+    }
+
+    void rememberSlot(uint64_t key, size_t slot)
+    {
+        if (_config.entityKeys) {
+            // Replaces the slot of an older version of the entity, if any.
+            _slotByIndex.set(
+                entityIndex(key), static_cast<SparseIndex::Slot>(slot));
+        } else {
+            _slotByKey[key] = slot;
+        }
+    }
+
+    static Entity::ValueType entityIndex(uint64_t key)
+    {
+        return Entity{static_cast<Entity::ValueType>(key)}.index();
+    }
+
+    // Drops the keys of all queued events. Entity keys are erased one by one,
+    // so this costs as much as the events themselves.
+    void forgetSlots()
+    {
+        if (_config.overflow != OverflowPolicy::Coalesce) {
+            return;
+        }
+        if (_config.entityKeys) {
+            for (const auto& event : _events) {
+                _slotByIndex.erase(entityIndex(_config.key(event)));
+            }
+        } else {
+            _slotByKey.clear();
+        }
+    }
+
+    EventQueueConfig<Event> _config;
+    EventQueueStats _stats;
+    std::vector<Event> _events;
+    std::vector<Event> _delivering;
+    size_t _head = 0;
+    std::unordered_map<uint64_t, size_t> _slotByKey;
+    SparseIndex _slotByIndex;
+    std::vector<Subscription> _subscriptions;
+};
+
+class Channel;
+
+class AbstractStagedEvents {
+public:
+    virtual ~AbstractStagedEvents() = default;
+
+    [[nodiscard]] virtual bool empty() const = 0;
+
+    // Moves the events of all parts, which must be of the same type as this
+    // one, into the channel's queue.
+    virtual void drain(
+        std::span<AbstractStagedEvents* const> parts,
+        Channel& channel) = 0;
+};
+
+// Events of one type pushed by one thread since the last delivery.
+template <class Event>
+class StagedEvents : public AbstractStagedEvents {
+public:
+    template <class E>
+    void push(E&& event)
+    {
+        _events.push_back(std::forward<E>(event));
+    }
+
+    [[nodiscard]] bool empty() const override
+    {
+        return _events.empty();
+    }
+
+    void drain(
+        std::span<AbstractStagedEvents* const> parts,
+        Channel& channel) override;
+
+private:
+    std::vector<Event> _events;
+    std::vector<std::pair<uint64_t, Event*>> _order;
+};
+
+// Routes events to subscribers. Each event type has its own typed queue, so
+// delivery calls the handlers directly. Queues are delivered, and emptied, in
+// their configured delivery order.
+//
+// Any thread may push. Every thread appends to staging buffers of its own,
+// registered with the channel once with a single compare-and-swap, so pushes
+// neither lock nor contend. Staged events reach their queues at the start of
+// the next delivery; pushes must not overlap with deliver() itself.
+//
+// Subscriptions belong to handler groups. Delivering on a thread pool runs
+// the groups concurrently, keeping main-thread groups on the calling thread.
 class Channel {
 public:
+    // The default group: ordered, and run on the thread calling deliver().
+    static constexpr HandlerGroupId MainThreadGroup = 0;
+
+    Channel()
+    {
+        _groups.push_back(HandlerGroup{
+            .affinity = HandlerAffinity::MainThread,
+            .ordered = true,
+        });
+    }
+
+    HandlerGroupId addGroup(const HandlerGroup& group)
+    {
+        _groups.push_back(group);
+        return static_cast<HandlerGroupId>(_groups.size() - 1);
+    }
+
     template <class Event>
     void push(Event&& event)
     {
-        _events.push_back(std::forward<Event>(event));
-        _typeInfos.push_back(typeid(Event));
+        using Type = std::remove_cvref_t<Event>;
+        auto& buffers = localStaging().buffers;
+        auto id = eventTypeId<Type>();
+        if (id >= buffers.size()) {
+            buffers.resize(id + 1);
+        }
+        if (!buffers[id]) {
+            buffers[id] = std::make_unique<StagedEvents<Type>>();
+        }
+        static_cast<StagedEvents<Type>&>(*buffers[id])
+            .push(std::forward<Event>(event));
     }
 
     template <class Event, std::invocable<const Event&> Handler>
-    void subscribe(Handler&& handler, const LifeHolder& lifeHolder)
+    void subscribe(
+        Handler&& handler,
+        const LifeHolder& lifeHolder,
+        HandlerGroupId group = MainThreadGroup)
     {
-        auto typeIndex = std::type_index{typeid(Event)};
-
-        _subscriberMap[typeIndex].push_back(Subscription{
-            .tracker = lifeHolder.tracker(),
-            .handler =
-                [handler](const std::any& event) {
-                    handler(std::any_cast<const Event&>(event));
-                },
-        });
+        if (group >= _groups.size()) {
+            throw std::out_of_range{"Channel: unknown handler group"};
+        }
+        queue<Event>().subscribe(
+            std::forward<Handler>(handler), lifeHolder, group);
     }
 
     template <class Event, std::invocable<const Event&> Handler>
-    [[nodiscard]] LifeHolder subscribe(Handler&& handler)
+    [[nodiscard]] LifeHolder
+    subscribe(Handler&& handler, HandlerGroupId group = MainThreadGroup)
     {
         auto lifeHolder = LifeHolder{};
-        subscribe<Event>(handler, lifeHolder);
+        subscribe<Event>(std::forward<Handler>(handler), lifeHolder, group);
         return lifeHolder;
     }
 
+    template <class Event>
+    void configure(const EventQueueConfig<Event>& config)
+    {
+        queue<Event>().configure(config);
+    }
+
+    template <class Event>
+    [[nodiscard]] EventQueueStats stats() const
+    {
+        auto id = eventTypeId<Event>();
+        if (id >= _queues.size() || !_queues[id]) {
+            return {};
+        }
+        return static_cast<const EventQueue<Event>&>(*_queues[id]).stats();
+    }
+
+    // Delivers everything on the calling thread, group by group.
     void deliver()
     {
-        for (size_t i = 0; i < _events.size(); i++) {
-            const auto& event = _events.at(i);
-            const auto& typeInfo = _typeInfos.at(i);
-            auto typeIndex = std::type_index{typeInfo};
-
-            auto& subs = _subscriberMap.at(typeIndex);
-            for (size_t j = 0; j < subs.size();) {
-                if (subs.at(j).tracker) {
-                    subs.at(j).handler(event);
-                    j++;
-                } else {
-                    if (j + 1 < subs.size()) {
-                        std::swap(subs.at(j), subs.back());
+        prepare();
+        auto finisher = Finisher{*this};
+        for (HandlerGroupId group = 0; group < _groups.size(); group++) {
+            deliverGroup(group);
+        }
+    }
+
+    // Delivers pool groups on the thread pool while the calling thread takes
+    // care of main-thread groups, then helps the pool until all are done.
+    void deliver(ThreadPool& pool)
+    {
+        prepare();
+        auto finisher = Finisher{*this};
+
+        auto remaining = std::atomic<size_t>{0};
+        auto error = std::exception_ptr{};
+        auto errorMutex = std::mutex{};
+        auto run = [&](auto function) {
+            remaining++;
+            pool.submit([&, function] {
+                try {
+                    function();
+                } catch (...) {
+                    auto lock = std::scoped_lock{errorMutex};
+                    error = std::current_exception();
+                }
+                remaining--;
+            });
+        };
+
+        for (HandlerGroupId group = 0; group < _groups.size(); group++) {
+            if (_groups[group].affinity != HandlerAffinity::Pool) {
+                continue;
+            }
+            if (_groups[group].ordered) {
+                run([this, group] { deliverGroup(group); });
+                continue;
+            }
+            for (auto* queue : _prepared) {
+                for (size_t i = 0; i < queue->subscriptionCount(); i++) {
+                    if (queue->group(i) == group) {
+                        run([queue, i] { queue->deliverTo(i); });
                     }
-                    subs.resize(subs.size() - 1);
                 }
             }
         }
+
+        try {
+            for (HandlerGroupId group = 0; group < _groups.size(); group++) {
+                if (_groups[group].affinity == HandlerAffinity::MainThread) {
+                    deliverGroup(group);
+                }
+            }
+        } catch (...) {
+            pool.wait(remaining);
+            throw;
+        }
+        pool.wait(remaining);
+
+        if (error) {
+            std::rethrow_exception(error);
+        }
     }
 
 private:
-    struct Subscription {
-        LifeTracker tracker;
-        std::function<void(const std::any& event)> handler;
+    // Finishes the prepared queues however delivery ends. A throwing handler
+    // would otherwise leave its events to be delivered once more.
+    struct Finisher {
+        explicit Finisher(Channel& channel)
+            : channel(channel)
+        { }
+
+        Finisher(const Finisher&) = delete;
+        Finisher& operator=(const Finisher&) = delete;
+
+        ~Finisher()
+        {
+            channel.finish();
+        }
+
+        Channel& channel;
     };
 
-    std::vector<std::any> _events;
-    std::vector<std::reference_wrapper<const std::type_info>> _typeInfos;
-    std::map<std::type_index, std::vector<Subscription>> _subscriberMap;
+    struct Staging {
+        Staging* next = nullptr;
+        std::vector<std::unique_ptr<AbstractStagedEvents>> buffers;
+    };
+
+    // Kept behind a pointer so that the channel stays movable.
+    struct StagingList {
+        StagingList() = default;
+        StagingList(const StagingList&) = delete;
+        StagingList& operator=(const StagingList&) = delete;
+
+        ~StagingList()
+        {
+            for (auto* staging = head.load(); staging;) {
+                delete std::exchange(staging, staging->next);
+            }
+        }
+
+        static uint64_t nextSerial()
+        {
+            static auto next = std::atomic<uint64_t>{0};
+            return next++;
+        }
+
+        std::atomic<Staging*> head = nullptr;
+        const uint64_t serial = nextSerial();
+    };
+
+    // The calling thread's staging buffers, found through a thread-local
+    // cache keyed by channel serial, since addresses may be reused.
+    Staging& localStaging()
+    {
+        thread_local auto cache =
+            std::vector<std::pair<uint64_t, Staging*>>{};
+        for (const auto& [serial, staging] : cache) {
+            if (serial == _staging->serial) {
+                return *staging;
+            }
+        }
+
+        auto* staging = new Staging{};
+        staging->next = _staging->head.load(std::memory_order_relaxed);
+        while (!_staging->head.compare_exchange_weak(
+            staging->next,
+            staging,
+            std::memory_order_release,
+            std::memory_order_relaxed)) { }
+        cache.emplace_back(_staging->serial, staging);
+        return *staging;
+    }
+
+    // Moves staged events into their queues, one event type at a time, so
+    // that parts pushed by different threads can be merged.
+    void mergeStaged()
+    {
+        auto typeCount = size_t{0};
+        auto* head = _staging->head.load(std::memory_order_acquire);
+        for (auto* staging = head; staging; staging = staging->next) {
+            typeCount = std::max(typeCount, staging->buffers.size());
+        }
+
+        for (size_t type = 0; type < typeCount; type++) {
+            _parts.clear();
+            for (auto* staging = head; staging; staging = staging->next) {
+                auto* part = type < staging->buffers.size()
+                    ? staging->buffers[type].get()
+                    : nullptr;
+                if (part && !part->empty()) {
+                    _parts.push_back(part);
+                }
+            }
+            if (!_parts.empty()) {
+                _parts.front()->drain(_parts, *this);
+            }
+        }
+    }
+
+    // Queues are captured here, so that handlers creating new queues while
+    // the others are being delivered do not disturb the delivery.
+    void prepare()
+    {
+        mergeStaged();
+        _prepared.clear();
+        for (const auto& queue : _queues) {
+            if (queue) {
+                queue->prepare();
+                _prepared.push_back(queue.get());
+            }
+        }
+        std::ranges::stable_sort(
+            _prepared, {}, &AbstractEventQueue::deliveryOrder);
+    }
+
+    void deliverGroup(HandlerGroupId group)
+    {
+        for (auto* queue : _prepared) {
+            for (size_t i = 0; i < queue->subscriptionCount(); i++) {
+                if (queue->group(i) == group) {
+                    queue->deliverTo(i);
+                }
+            }
+        }
+    }
+
+    void finish()
+    {
+        for (auto* queue : _prepared) {
+            queue->finish();
+        }
+        _prepared.clear();
+    }
+
+    template <class Event>
+    EventQueue<Event>& queue()
+    {
+        auto id = eventTypeId<Event>();
+        if (id >= _queues.size()) {
+            _queues.resize(id + 1);
+        }
+        if (!_queues[id]) {
+            _queues[id] = std::make_unique<EventQueue<Event>>();
+        }
+        return static_cast<EventQueue<Event>&>(*_queues[id]);
+    }
+
+    std::vector<HandlerGroup> _groups;
+    std::vector<std::unique_ptr<AbstractEventQueue>> _queues;
+    std::vector<AbstractEventQueue*> _prepared;
+    std::unique_ptr<StagingList> _staging = std::make_unique<StagingList>();
+    std::vector<AbstractStagedEvents*> _parts;
+
+    template <class Event>
+    friend class StagedEvents;
 };
 
+template <class Event>
+void StagedEvents<Event>::drain(
+    std::span<AbstractStagedEvents* const> parts,
+    Channel& channel)
+{
+    auto& queue = channel.queue<Event>();
+    auto order = queue.config().order;
+    if (!order) {
+        for (auto* part : parts) {
+            auto& events = static_cast<StagedEvents&>(*part)._events;
+            for (auto& event : events) {
+                queue.push(std::move(event));
+            }
+            events.clear();
+        }
+        return;
+    }
+
+    _order.clear();
+    for (auto* part : parts) {
+        for (auto& event : static_cast<StagedEvents&>(*part)._events) {
+            _order.emplace_back(order(event), &event);
+        }
+    }
+    std::ranges::stable_sort(_order, {}, &std::pair<uint64_t, Event*>::first);
+    for (auto [key, event] : _order) {
+        queue.push(std::move(*event));
+    }
+    for (auto* part : parts) {
+        static_cast<StagedEvents&>(*part)._events.clear();
+    }
+}
+
 class Subscriber {
 public:
     template <class Event, std::invocable<const Event&> Handler>
     void subscribe(Channel& channel, Handler&& handler)
     {
-        channel.subscribe(std::forward<Handler>(handler), _lifeTracker);
+        channel.subscribe<Event>(std::forward<Handler>(handler), _lifeTracker);
     }
 
 private:
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "component-id.hpp"
+#include "entity.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+template <class EcsType>
+class CommandBuffers;
+
+// Records structural changes (creating entities, adding components, killing
+// entities) so that systems can request them while iterating, without
+// invalidating the spans and references they are working with. The changes
+// are applied when the owning Ecs is flushed.
+template <class EcsType>
+class CommandBuffer {
+public:
+    explicit CommandBuffer(EcsType& ecs)
+        : _ecs(ecs)
+    { }
+
+    // The entity is reserved right away, but only becomes alive when the
+    // buffer is applied.
+    Entity create()
+    {
+        return _ecs.reserve();
+    }
+
+    template <class Component>
+    void add(Entity entity, Component&& component)
+    {
+        using Type = std::remove_cvref_t<Component>;
+        addQueue<Type>().adds.emplace_back(
+            entity, std::forward<Component>(component));
+    }
+
+    void kill(Entity entity)
+    {
+        _kills.push_back(entity);
+    }
+
+private:
+    struct AbstractAddQueue {
+        virtual ~AbstractAddQueue() = default;
+        virtual void apply(EcsType& ecs) = 0;
+    };
+
+    template <class Component>
+    struct AddQueue : AbstractAddQueue {
+        void apply(EcsType& ecs) override
+        {
+            for (auto& [entity, component] : adds) {
+                if (ecs.alive(entity)) {
+                    ecs.add(entity, std::move(component));
+                }
+            }
+            adds.clear();
+        }
+
+        std::vector<std::pair<Entity, Component>> adds;
+    };
+
+    template <class Component>
+    AddQueue<Component>& addQueue()
+    {
+        auto id = componentId<Component>();
+        if (id >= _addQueues.size()) {
+            _addQueues.resize(id + 1);
+        }
+        if (!_addQueues[id]) {
+            _addQueues[id] = std::make_unique<AddQueue<Component>>();
+        }
+        return static_cast<AddQueue<Component>&>(*_addQueues[id]);
+    }
+
+    EcsType& _ecs;
+    std::vector<std::unique_ptr<AbstractAddQueue>> _addQueues;
+    std::vector<Entity> _kills;
+
+    friend class CommandBuffers<EcsType>;
+};
+
+// One command buffer per thread, so recording never contends. Applying them
+// adds components type by type, then kills the collected entities in index
+// order, each at most once.
+template <class EcsType>
+class CommandBuffers {
+public:
+    // Finds the calling thread's buffer through a thread-local cache keyed by
+    // serial, since addresses may be reused; the lock is only taken the first
+    // time a thread records.
+    CommandBuffer<EcsType>& local(EcsType& ecs)
+    {
+        thread_local auto cache =
+            std::vector<std::pair<uint64_t, CommandBuffer<EcsType>*>>{};
+        for (const auto& [serial, buffer] : cache) {
+            if (serial == _serial) {
+                return *buffer;
+            }
+        }
+
+        auto lock = std::scoped_lock{_mutex};
+        auto& buffer = _buffers.emplace_back(
+            std::make_unique<CommandBuffer<EcsType>>(ecs));
+        cache.emplace_back(_serial, buffer.get());
+        return *buffer;
+    }
+
+    // Must not overlap with recording.
+    void apply(EcsType& ecs)
+    {
+        auto lock = std::scoped_lock{_mutex};
+        for (auto& buffer : _buffers) {
+            for (auto& queue : buffer->_addQueues) {
+                if (queue) {
+                    queue->apply(ecs);
+                }
+            }
+            _kills.insert(
+                _kills.end(), buffer->_kills.begin(), buffer->_kills.end());
+            buffer->_kills.clear();
+        }
+
+        std::ranges::sort(_kills, [](Entity lhs, Entity rhs) {
+            return lhs.index() < rhs.index();
+        });
+        auto [first, last] = std::ranges::unique(_kills);
+        _kills.erase(first, last);
+        ecs.killMany(_kills);
+        _kills.clear();
+    }
+
+private:
+    static uint64_t nextSerial()
+    {
+        static auto next = std::atomic<uint64_t>{0};
+        return next++;
+    }
+
+    const uint64_t _serial = nextSerial();
+    std::mutex _mutex;
+    std::vector<std::unique_ptr<CommandBuffer<EcsType>>> _buffers;
+    std::vector<Entity> _kills;
+};
\ No newline at end of file
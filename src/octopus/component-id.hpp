@@ -0,0 +1,21 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+using ComponentId = uint32_t;
+
+inline ComponentId nextComponentId()
+{
+    static auto next = std::atomic<ComponentId>{0};
+    return next++;
+}
+
+// Dense per-type id, assigned on first use. Storages are kept in flat arrays
+// indexed by it, so finding a storage is a single indexed load.
+template <class Component>
+ComponentId componentId()
+{
+    static const auto id = nextComponentId();
+    return id;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+// An entity handle packs a slot index together with the version of that slot.
+// Killing an entity bumps the version, so handles to recycled slots can be
+// told apart from live ones without any lookups.
+class Entity {
+public:
+    using ValueType = uint32_t;
+
+    static constexpr int IndexBits = 22;
+    static constexpr ValueType IndexMask = (ValueType{1} << IndexBits) - 1;
+    static constexpr ValueType VersionMask = ~ValueType{0} >> IndexBits;
+
+    Entity() = default;
+
+    explicit constexpr Entity(ValueType id)
+        : _id(id)
+    { }
+
+    constexpr Entity(ValueType index, ValueType version)
+        : _id((index & IndexMask) | ((version & VersionMask) << IndexBits))
+    { }
+
+    constexpr operator ValueType() const
+    {
+        return _id;
+    }
+
+    [[nodiscard]] constexpr ValueType index() const
+    {
+        return _id & IndexMask;
+    }
+
+    [[nodiscard]] constexpr ValueType version() const
+    {
+        return _id >> IndexBits;
+    }
+
+    constexpr auto operator<=>(const Entity&) const = default;
+
+private:
+    ValueType _id = 0;
+};
+
+class EntityPool {
+public:
+    Entity create()
+    {
+        auto entity = reserve();
+        commitReserved();
+        return entity;
+    }
+
+    // Hands out an entity without touching the tables alive() reads, so it is
+    // safe to call from several threads while others query the pool. The
+    // entity, fresh or recycled, only becomes alive after commitReserved().
+    // Every reservation is committed, so an unneeded one must be killed like
+    // any other entity.
+    Entity reserve()
+    {
+        auto lock = std::scoped_lock{_reserveMutex};
+        if (!_freeIndices.empty()) {
+            auto index = _freeIndices.back();
+            _freeIndices.pop_back();
+            _pending.push_back(index);
+            return Entity{index, _versions[index]};
+        }
+
+        if (_end > Entity::IndexMask) {
+            throw std::length_error{"EntityPool: out of entity indices"};
+        }
+        _pending.push_back(_end);
+        return Entity{_end++, 0};
+    }
+
+    // Must not overlap with reserve() or alive().
+    void commitReserved()
+    {
+        _versions.resize(_end, 0);
+        _live.resize(_end, false);
+        for (auto index : _pending) {
+            _live[index] = true;
+        }
+        _pending.clear();
+    }
+
+    [[nodiscard]] size_t size() const
+    {
+        return _versions.size();
+    }
+
+    void kill(Entity entity)
+    {
+        auto nextVersion = (entity.version() + 1) & Entity::VersionMask;
+        _versions[entity.index()] = nextVersion;
+        _live[entity.index()] = false;
+        _freeIndices.push_back(entity.index());
+    }
+
+    [[nodiscard]] bool alive(Entity entity) const
+    {
+        return entity.index() < _versions.size() && _live[entity.index()] &&
+            _versions[entity.index()] == entity.version();
+    }
+
+private:
+    // The version the index is, or will be, handed out with.
+    std::vector<Entity::ValueType> _versions;
+    // Whether the index holds a committed, not yet killed entity.
+    std::vector<bool> _live;
+    std::vector<Entity::ValueType> _freeIndices;
+    std::vector<Entity::ValueType> _pending;
+    Entity::ValueType _end = 0;
+    std::mutex _reserveMutex;
+};
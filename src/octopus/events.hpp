@@ -4,8 +4,6 @@
 #include "ecs.hpp"
 #include "world.hpp"
 
-inline Channel events;
-
 struct AddObjectEvent {
     Entity id;
     ObjectType type;
@@ -21,3 +19,24 @@ struct MoveObjectEvent {
 struct HissEvent {
     Entity entity;
 };
+
+// Objects are added before they move, whatever order the event types were
+// first used in. Only the last position of an entity matters to the scene, so
+// moves of the same entity between deliveries collapse into one.
+inline Channel makeEventChannel()
+{
+    auto channel = Channel{};
+    channel.configure<AddObjectEvent>({});
+    channel.configure<MoveObjectEvent>({
+        .overflow = OverflowPolicy::Coalesce,
+        .key = [](const MoveObjectEvent& event) -> uint64_t {
+            return event.id;
+        },
+        .entityKeys = true,
+        .deliveryOrder = 1,
+    });
+    channel.configure<HissEvent>({});
+    return channel;
+}
+
+inline Channel events = makeEventChannel();
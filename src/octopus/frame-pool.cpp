@@ -0,0 +1,155 @@
+#include "frame-pool.hpp"
+
+#include <array>
+#include <atomic>
+#include <new>
+#include <utility>
+
+namespace {
+
+constexpr size_t Granularity = 64;
+constexpr size_t BucketCount = 32;
+
+std::atomic<uint64_t> allocations = 0;
+std::atomic<uint64_t> heapAllocations = 0;
+
+class Cache;
+
+// Sits in front of every frame. Remembers the cache the frame goes back to,
+// and links the frame into a list while it is free.
+struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) FrameHeader {
+    Cache* owner = nullptr;
+    FrameHeader* next = nullptr;
+};
+
+// Marks the remote lists of a cache whose thread has exited.
+FrameHeader closedList;
+
+void release(FrameHeader* head)
+{
+    while (head) {
+        ::operator delete(std::exchange(head, head->next));
+    }
+}
+
+// The free lists of one thread. Only the owning thread touches the local
+// lists; other threads hand frames back through the remote ones, which the
+// owner takes over whenever a local list runs dry.
+class Cache {
+public:
+    FrameHeader* pop(size_t bucket)
+    {
+        auto*& head = _local[bucket];
+        if (!head) {
+            head = _remote[bucket].exchange(nullptr, std::memory_order_acquire);
+        }
+        if (!head) {
+            return nullptr;
+        }
+        return std::exchange(head, head->next);
+    }
+
+    void push(size_t bucket, FrameHeader* frame)
+    {
+        frame->next = std::exchange(_local[bucket], frame);
+    }
+
+    void pushRemote(size_t bucket, FrameHeader* frame)
+    {
+        auto& head = _remote[bucket];
+        auto* next = head.load(std::memory_order_relaxed);
+        do {
+            if (next == &closedList) {
+                ::operator delete(frame);
+                return;
+            }
+            frame->next = next;
+        } while (!head.compare_exchange_weak(
+            next, frame, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    // Frees the cached frames. Frames returned afterwards go to the heap.
+    void close()
+    {
+        for (size_t bucket = 0; bucket < BucketCount; bucket++) {
+            release(std::exchange(_local[bucket], nullptr));
+            release(_remote[bucket].exchange(
+                &closedList, std::memory_order_acquire));
+        }
+    }
+
+private:
+    std::array<FrameHeader*, BucketCount> _local{};
+    std::array<std::atomic<FrameHeader*>, BucketCount> _remote{};
+};
+
+// Both are trivially destructible, so they can still be read while the
+// thread's other thread-locals are being destroyed.
+thread_local Cache* cache = nullptr;
+thread_local bool threadExited = false;
+
+// The cache itself is never deleted: frames it handed out may still come back
+// from other threads. There is one per thread that ever ran a coroutine.
+struct CacheCloser {
+    ~CacheCloser()
+    {
+        threadExited = true;
+        std::exchange(cache, nullptr)->close();
+    }
+};
+
+Cache* threadCache()
+{
+    if (!cache && !threadExited) {
+        cache = new Cache;
+        thread_local CacheCloser closer;
+    }
+    return cache;
+}
+
+size_t bucketFor(size_t size)
+{
+    return (size + sizeof(FrameHeader) + Granularity - 1) / Granularity - 1;
+}
+
+} // namespace
+
+void* allocateFrame(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+
+    auto bucket = bucketFor(size);
+    auto* owner = bucket < BucketCount ? threadCache() : nullptr;
+    if (owner) {
+        if (auto* frame = owner->pop(bucket)) {
+            frame->owner = owner;
+            return frame + 1;
+        }
+    }
+
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    auto* memory = ::operator new(
+        bucket < BucketCount ? (bucket + 1) * Granularity
+                             : size + sizeof(FrameHeader));
+    return new (memory) FrameHeader{.owner = owner} + 1;
+}
+
+void deallocateFrame(void* frame, size_t size)
+{
+    auto* header = static_cast<FrameHeader*>(frame) - 1;
+    if (!header->owner) {
+        ::operator delete(header);
+    } else if (header->owner == cache) {
+        cache->push(bucketFor(size), header);
+    } else {
+        header->owner->pushRemote(bucketFor(size), header);
+    }
+}
+
+FramePoolStats framePoolStats()
+{
+    return FramePoolStats{
+        .allocations = allocations.load(std::memory_order_relaxed),
+        .heapAllocations = heapAllocations.load(std::memory_order_relaxed),
+    };
+}
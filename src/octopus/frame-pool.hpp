@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Recycles coroutine frames. Freed frames are kept on per-thread free lists,
+// bucketed by size, so a coroutine started over and over again reuses the
+// same memory instead of going to the heap every time. A frame freed on
+// another thread than the one that allocated it is handed back to its owner.
+// Frames larger than the biggest bucket are passed straight to the heap.
+void* allocateFrame(size_t size);
+void deallocateFrame(void* frame, size_t size);
+
+struct FramePoolStats {
+    uint64_t allocations = 0;
+    // Allocations that could not be served from a free list.
+    uint64_t heapAllocations = 0;
+};
+
+FramePoolStats framePoolStats();
@@ -219,6 +219,7 @@ struct ScreenTag;
 
 using WorldPosition = Point<float, WorldTag>;
 using WorldVector = Vector<float, WorldTag>;
+using WorldRect = Rect<float, WorldTag>;
 
 using ScreenPosition = Point<float, ScreenTag>;
 using ScreenRect = Rect<float, ScreenTag>;
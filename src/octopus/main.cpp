@@ -1,3 +1,4 @@
+#include "atlas.hpp"
 #include "build-info.hpp"
 #include "events.hpp"
 #include "geometry.hpp"
@@ -10,8 +11,7 @@
 #include <chrono>
 #include <cmath>
 #include <cstdlib>
-#include <map>
-#include <thread>
+#include <string_view>
 #include <vector>
 
 #include <format>
@@ -31,8 +31,6 @@ struct KeyboardController {
 
 int main(int, char*[])
 {
-    using namespace std::chrono_literals;
-
     auto sdlInit = sdl::Init{SDL_INIT_VIDEO | SDL_INIT_AUDIO};
     auto imgInit = img::Init{IMG_INIT_PNG};
 
@@ -47,65 +45,30 @@ int main(int, char*[])
     auto renderer = sdl::Renderer{
         window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC};
 
-    auto heroTexture =
-        renderer.loadTexture(build_info::assets / "images" / "hero.png");
-    auto heroSize = heroTexture.size();
-    auto heroSprite = Sprite{
-        .texture = &heroTexture,
-        .frames =
-            {
-                SDL_Rect{0, 0, heroSize.w, heroSize.h},
-            },
-        .frameDuration = 200ms,
-    };
-
-    auto scorpionTexture =
-        renderer.loadTexture(build_info::assets / "images" / "scorpion.png");
-    auto scorpionSize = scorpionTexture.size();
-    auto scorpionSprite = Sprite{
-        .texture = &scorpionTexture,
-        .frames =
-            {
-                SDL_Rect{0, 0, scorpionSize.w, scorpionSize.h},
-            },
-    };
-
-    auto treeTexture =
-        renderer.loadTexture(build_info::assets / "images" / "tree.png");
-    auto treeSize = treeTexture.size();
-    auto treeSprite = Sprite{
-        .texture = &treeTexture,
-        .frames =
-            {
-                SDL_Rect{0, 0, treeSize.w, treeSize.h},
-            },
-    };
+    auto scene = Scene{};
+    scene.camera().center(0.f, 0.f);
+    scene.camera().viewport(0, 0, window.size().w, window.size().h);
+    scene.camera().pixelsPerUnit(32);
+    scene.camera().zoom(2);
 
-    auto chestTexture =
-        renderer.loadTexture(build_info::assets / "images" / "chest.png");
-    auto chestSize = chestTexture.size();
-    auto chestSprite = Sprite{
-        .texture = &chestTexture,
-        .frames =
-            {
-                SDL_Rect{0, 0, chestSize.w, chestSize.h},
-            },
+    // All images share one atlas texture, so the scene is drawn in a single
+    // batch.
+    auto atlas = Atlas{renderer, build_info::assets / "images"};
+    auto spriteFromAtlas = [&atlas, &scene](std::string_view name) {
+        const auto& region = atlas.region(name);
+        return scene.addSprite(
+            Sprite{.texture = region.texture, .frames = {region.rect}});
     };
 
-    auto houseTexture =
-        renderer.loadTexture(build_info::assets / "images" / "house.png");
-    auto houseSize = houseTexture.size();
-    auto houseSprite = Sprite{
-        .texture = &houseTexture,
-        .frames =
-            {
-                SDL_Rect{0, 0, houseSize.w, houseSize.h},
-            },
-    };
+    auto heroSprite = spriteFromAtlas("hero");
+    auto scorpionSprite = spriteFromAtlas("scorpion");
+    auto treeSprite = spriteFromAtlas("tree");
+    auto chestSprite = spriteFromAtlas("chest");
+    auto houseSprite = spriteFromAtlas("house");
 
     auto spriteForObject =
-        [&heroSprite, &scorpionSprite, &treeSprite, &chestSprite, &houseSprite](
-            ObjectType objectType) -> const Sprite& {
+        [heroSprite, scorpionSprite, treeSprite, chestSprite, houseSprite](
+            ObjectType objectType) {
         switch (objectType) {
             case ObjectType::Hero: return heroSprite;
             case ObjectType::Scorpion: return scorpionSprite;
@@ -117,22 +80,16 @@ int main(int, char*[])
             "unknown ObjectType: {}", std::to_underlying(objectType))};
     };
 
-    auto scene = Scene{};
-    scene.camera().center(0.f, 0.f);
-    scene.camera().viewport(0, 0, window.size().w, window.size().h);
-    scene.camera().pixelsPerUnit(32);
-    scene.camera().zoom(2);
-
     std::vector<LifeHolder> lifeHolders;
 
     lifeHolders.push_back(events.subscribe<AddObjectEvent>(
         [&scene, &spriteForObject](const AddObjectEvent& e) {
             scene.addObject(e.id, spriteForObject(e.type), e.position);
         }));
-    lifeHolders.push_back(events.subscribe<
-                          MoveObjectEvent>([&scene](const MoveObjectEvent& e) {
-        scene.moveObject(e.id, e.position + WorldVector{0, 0.5f * e.height});
-    }));
+    lifeHolders.push_back(events.subscribe<MoveObjectEvent>(
+        [&scene](const MoveObjectEvent& e) {
+            scene.moveObject(e.id, e.position, e.height);
+        }));
 
     auto controller = KeyboardController{};
     auto world = World{};
@@ -167,10 +124,12 @@ int main(int, char*[])
         if (const int framesPassed = timer(); framesPassed > 0) {
             world.heroControl() = controller.control();
 
+            world.beginFrame();
             for (int i = 0; i < framesPassed; i++) {
                 world.update(timer.delta());
             }
 
+            world.sync();
             events.deliver();
 
             scene.update((float)framesPassed * timer.delta());
@@ -7,7 +7,9 @@
 
 namespace {
 
-Random _random;
+// Every thread gets its own engine, so that code running on the thread pool
+// can draw numbers without synchronizing.
+thread_local Random _random;
 
 } // namespace
 
@@ -0,0 +1,74 @@
+#include "render-queue.hpp"
+
+#include <array>
+#include <bit>
+#include <utility>
+
+namespace {
+
+constexpr int DigitBits = 8;
+constexpr size_t DigitCount = 1 << DigitBits;
+constexpr int LastDigit = 64 / DigitBits - 1;
+
+// Maps a float onto an unsigned integer with the same ordering.
+uint32_t orderedBits(float value)
+{
+    auto bits = std::bit_cast<uint32_t>(value);
+    return (bits & 0x8000'0000) ? ~bits : bits | 0x8000'0000;
+}
+
+} // namespace
+
+void RenderQueue::clear()
+{
+    _keys.clear();
+}
+
+void RenderQueue::push(uint8_t layer, float depth, uint8_t atlas, uint32_t id)
+{
+    // The top 24 bits keep 15 bits of mantissa, so the step between depths
+    // is 1/64 of a unit below 1024 units and 1/32 below 2048.
+    auto depthBits = orderedBits(depth) >> 8;
+    _keys.push_back(
+        (uint64_t{layer} << 56) | (uint64_t{depthBits} << 32) |
+        (uint64_t{atlas} << 24) | (id & IdMask));
+}
+
+void RenderQueue::sort()
+{
+    if (_keys.size() < 2) {
+        return;
+    }
+
+    // One pass over the keys counts all digits at once.
+    auto counts = std::array<std::array<size_t, DigitCount>, 8>{};
+    for (auto key : _keys) {
+        for (auto digit = 0; digit <= LastDigit; digit++) {
+            counts[digit][(key >> (digit * DigitBits)) & (DigitCount - 1)]++;
+        }
+    }
+
+    _scratch.resize(_keys.size());
+    for (auto digit = 0; digit <= LastDigit; digit++) {
+        auto& digitCounts = counts[digit];
+        auto shift = digit * DigitBits;
+        if (digitCounts[(_keys.front() >> shift) & (DigitCount - 1)] ==
+            _keys.size()) {
+            continue;
+        }
+
+        auto offset = size_t{0};
+        for (auto& count : digitCounts) {
+            offset += std::exchange(count, offset);
+        }
+        for (auto key : _keys) {
+            _scratch[digitCounts[(key >> shift) & (DigitCount - 1)]++] = key;
+        }
+        _keys.swap(_scratch);
+    }
+}
+
+std::span<const uint64_t> RenderQueue::keys() const
+{
+    return _keys;
+}
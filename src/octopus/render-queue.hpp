@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Orders draws by packed 64-bit keys. From the top, a key holds the layer
+// (8 bits), the depth (24 bits), the atlas texture (8 bits) and the id of
+// the object to draw (24 bits). Sorting the keys therefore draws layer by
+// layer, back to front, and groups equally deep sprites by texture. Objects
+// that tie on all of these are drawn in id order, so ids should stay the same
+// from frame to frame, or overlapping objects flicker.
+//
+// Keys are sorted with a least significant digit radix sort. Digits that every
+// key shares are skipped, so constant fields such as a single layer or a
+// single atlas cost nothing.
+class RenderQueue {
+public:
+    static constexpr int IdBits = 24;
+    static constexpr uint32_t IdMask = (uint32_t{1} << IdBits) - 1;
+
+    void clear();
+
+    // Larger depths are drawn later. The id must fit in IdBits.
+    void push(uint8_t layer, float depth, uint8_t atlas, uint32_t id);
+
+    void sort();
+
+    [[nodiscard]] std::span<const uint64_t> keys() const;
+
+    static uint32_t id(uint64_t key)
+    {
+        return static_cast<uint32_t>(key) & IdMask;
+    }
+
+private:
+    std::vector<uint64_t> _keys;
+    std::vector<uint64_t> _scratch;
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free queue for any number of producers and consumers. Every
+// cell carries a sequence number telling whose turn it is, so producers and
+// consumers only ever contend on a single atomic increment each.
+template <class T, size_t Capacity>
+class RingBuffer {
+    static_assert(
+        Capacity > 1 && (Capacity & (Capacity - 1)) == 0,
+        "RingBuffer capacity must be a power of two");
+
+public:
+    RingBuffer()
+    {
+        for (size_t i = 0; i < Capacity; i++) {
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    // Returns false if the buffer is full.
+    bool tryPush(const T& value)
+    {
+        auto position = _pushPosition.load(std::memory_order_relaxed);
+        for (;;) {
+            auto& cell = _cells[position & Mask];
+            auto sequence = cell.sequence.load(std::memory_order_acquire);
+            auto difference = static_cast<std::ptrdiff_t>(sequence) -
+                static_cast<std::ptrdiff_t>(position);
+            if (difference == 0) {
+                if (_pushPosition.compare_exchange_weak(
+                        position, position + 1, std::memory_order_relaxed)) {
+                    cell.value = value;
+                    cell.sequence.store(
+                        position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = _pushPosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Returns false if the buffer is empty.
+    bool tryPop(T& value)
+    {
+        auto position = _popPosition.load(std::memory_order_relaxed);
+        for (;;) {
+            auto& cell = _cells[position & Mask];
+            auto sequence = cell.sequence.load(std::memory_order_acquire);
+            auto difference = static_cast<std::ptrdiff_t>(sequence) -
+                static_cast<std::ptrdiff_t>(position + 1);
+            if (difference == 0) {
+                if (_popPosition.compare_exchange_weak(
+                        position, position + 1, std::memory_order_relaxed)) {
+                    value = cell.value;
+                    cell.sequence.store(
+                        position + Capacity, std::memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = _popPosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    static constexpr size_t Mask = Capacity - 1;
+    static constexpr size_t CacheLine = 64;
+
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::array<Cell, Capacity> _cells;
+    alignas(CacheLine) std::atomic<size_t> _pushPosition = 0;
+    alignas(CacheLine) std::atomic<size_t> _popPosition = 0;
+};
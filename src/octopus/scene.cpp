@@ -1,44 +1,9 @@
 #include "scene.hpp"
 
-Object::Object(Sprite sprite, const WorldPosition& position)
-    : _sprite(std::move(sprite))
-    , _position(position)
-    , _startTime(Clock::now())
-    , _currentTime(_startTime)
-{ }
-
-[[nodiscard]] const sdl::Texture& Object::texture() const
-{
-    return *_sprite.texture;
-}
-
-[[nodiscard]] sdl::Texture& Object::texture()
-{
-    return *_sprite.texture;
-}
-
-[[nodiscard]] const SDL_Rect& Object::frame() const
-{
-    auto framesPassed = (_currentTime - _startTime) / _sprite.frameDuration;
-    auto frameIndex = framesPassed % _sprite.frames.size();
-    return _sprite.frames.at(frameIndex);
-}
-
-void Object::update(float delta)
-{
-    _currentTime += std::chrono::duration_cast<Clock::duration>(
-        std::chrono::duration<float>(delta));
-}
-
-[[nodiscard]] const WorldPosition& Object::position() const
-{
-    return _position;
-}
-
-void Object::moveTo(const WorldPosition& position)
-{
-    _position = position;
-}
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
 
 [[nodiscard]] ScreenPosition
 Camera::project(const WorldPosition& worldPosition) const
@@ -92,53 +57,173 @@ void Camera::zoom(float zoom)
     return _zoom;
 }
 
+[[nodiscard]] const ScreenRect& Camera::viewport() const
+{
+    return _viewport;
+}
+
+[[nodiscard]] WorldRect Camera::visibleArea(float margin) const
+{
+    // Screen y grows downwards, world y upwards.
+    auto topLeft = restore({_viewport.x - margin, _viewport.y - margin});
+    auto bottomRight = restore({
+        _viewport.x + _viewport.w + margin,
+        _viewport.y + _viewport.h + margin,
+    });
+    return WorldRect{
+        .x = topLeft.x,
+        .y = bottomRight.y,
+        .w = bottomRight.x - topLeft.x,
+        .h = topLeft.y - bottomRight.y,
+    };
+}
+
 [[nodiscard]] float Camera::screenPixelsPerUnit() const
 {
     return _pixelsPerUnit * _zoom;
 }
 
-void Scene::addObject(size_t id, Sprite sprite, WorldPosition position)
+SpriteId Scene::addSprite(Sprite sprite)
 {
-    _objects[id] = Object{std::move(sprite), position};
+    for (const auto& frame : sprite.frames) {
+        _maxSpriteSize = std::max({_maxSpriteSize, frame.w, frame.h});
+    }
+
+    auto atlas = std::ranges::find(_atlases, sprite.texture);
+    if (atlas == _atlases.end()) {
+        atlas = _atlases.insert(atlas, sprite.texture);
+    }
+    // Past 256 textures ids repeat, which only makes grouping less tight.
+    _spriteAtlases.push_back(
+        static_cast<uint8_t>(std::distance(_atlases.begin(), atlas)));
+
+    _sprites.push_back(std::move(sprite));
+    return static_cast<SpriteId>(_sprites.size() - 1);
 }
 
-void Scene::moveObject(size_t id, const WorldPosition& position)
+void Scene::addObject(Entity entity, SpriteId sprite, WorldPosition position)
 {
-    _objects.at(id).moveTo(position);
+    // A recycled index replaces whatever object its previous entity left.
+    if (auto slot = _slots.find(entity.index()); slot != SparseIndex::npos) {
+        remove(slot);
+    }
+
+    _slots.set(
+        entity.index(), static_cast<SparseIndex::Slot>(_entities.size()));
+    _entities.push_back(entity);
+    _spriteIds.push_back(sprite);
+    _positions.push_back(position);
+    _heights.push_back(0.f);
+    _startTimes.push_back(_time);
+    _grid.insert(entity.index(), position);
 }
 
-void Scene::killObject(size_t id)
+void Scene::moveObject(
+    Entity entity, const WorldPosition& position, float height)
 {
-    _objects.erase(id);
+    auto slot = this->slot(entity);
+    _positions[slot] = position;
+    _heights[slot] = height;
+    _maxHeight = std::max(_maxHeight, height);
+    _grid.move(entity.index(), position);
 }
 
-void Scene::update(float delta)
+void Scene::killObject(Entity entity)
 {
-    for (auto& [id, object] : _objects) {
-        object.update(delta);
+    auto slot = _slots.find(entity.index());
+    if (slot != SparseIndex::npos && _entities[slot] == entity) {
+        remove(slot);
     }
 }
 
-void Scene::render(sdl::Renderer& renderer)
+void Scene::update(float delta)
 {
-    for (auto& [id, object] : _objects) {
-        auto screenPosition = _camera.project(object.position());
+    _time += std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<float>(delta));
+}
+
+static_assert(
+    Entity::IndexBits <= RenderQueue::IdBits,
+    "entity indices must fit the render queue's ids");
 
-        renderer.copy(
-            object.texture(),
-            object.frame(),
+void Scene::render(sdl::Renderer& renderer)
+{
+    _queue.clear();
+    // Heights are drawn foreshortened to a half, see below.
+    auto margin = _camera.zoom() * (float)_maxSpriteSize / 2.f +
+        0.5f * _maxHeight * _camera.screenPixelsPerUnit();
+    _grid.query(_camera.visibleArea(margin), [this](size_t index) {
+        auto slot = _slots.find(static_cast<Entity::ValueType>(index));
+        auto sprite = _spriteIds[slot];
+        // World y grows away from the viewer, so lower objects go on top.
+        // Slots change as objects are removed, so ties are broken on the
+        // entity index instead.
+        _queue.push(
+            _sprites[sprite].layer,
+            -_positions[slot].y,
+            _spriteAtlases[sprite],
+            static_cast<uint32_t>(index));
+    });
+    _queue.sort();
+
+    for (auto key : _queue.keys()) {
+        auto slot = _slots.find(RenderQueue::id(key));
+        const auto& frame = this->frame(slot);
+        // Heights are drawn foreshortened to a half.
+        auto screenPosition = _camera.project(
+            _positions[slot] + WorldVector{0, 0.5f * _heights[slot]});
+
+        _batch.add(
+            *_sprites[_spriteIds[slot]].texture,
+            frame,
             SDL_FRect{
-                .x = screenPosition.x -
-                    _camera.zoom() * (float)object.frame().w / 2.f,
-                .y = screenPosition.y -
-                    _camera.zoom() * (float)object.frame().h / 2.f,
-                .w = _camera.zoom() * (float)object.frame().w,
-                .h = _camera.zoom() * (float)object.frame().h,
+                .x = screenPosition.x - _camera.zoom() * (float)frame.w / 2.f,
+                .y = screenPosition.y - _camera.zoom() * (float)frame.h / 2.f,
+                .w = _camera.zoom() * (float)frame.w,
+                .h = _camera.zoom() * (float)frame.h,
             });
     }
+    _batch.draw(renderer);
 }
 
 Camera& Scene::camera()
 {
     return _camera;
 }
+
+SparseIndex::Slot Scene::slot(Entity entity) const
+{
+    auto slot = _slots.find(entity.index());
+    if (slot == SparseIndex::npos || _entities[slot] != entity) {
+        throw std::out_of_range{"Scene: unknown object"};
+    }
+    return slot;
+}
+
+const SDL_Rect& Scene::frame(SparseIndex::Slot slot) const
+{
+    const auto& sprite = _sprites[_spriteIds[slot]];
+    auto framesPassed = (_time - _startTimes[slot]) / sprite.frameDuration;
+    return sprite.frames.at(framesPassed % sprite.frames.size());
+}
+
+void Scene::remove(SparseIndex::Slot slot)
+{
+    auto index = _entities[slot].index();
+    _grid.erase(index);
+
+    if (slot + 1 < _entities.size()) {
+        _entities[slot] = _entities.back();
+        _spriteIds[slot] = _spriteIds.back();
+        _positions[slot] = _positions.back();
+        _heights[slot] = _heights.back();
+        _startTimes[slot] = _startTimes.back();
+        _slots.set(_entities[slot].index(), slot);
+    }
+    _entities.pop_back();
+    _spriteIds.pop_back();
+    _positions.pop_back();
+    _heights.pop_back();
+    _startTimes.pop_back();
+    _slots.erase(index);
+}
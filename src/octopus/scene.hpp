@@ -1,11 +1,16 @@
 #pragma once
 
+#include "entity.hpp"
 #include "geometry.hpp"
+#include "render-queue.hpp"
+#include "sparse-index.hpp"
+#include "spatial-grid.hpp"
 
 #include "sdl.hpp"
 
 #include <chrono>
-#include <map>
+#include <cstdint>
+#include <vector>
 
 using Clock = std::chrono::high_resolution_clock;
 
@@ -13,28 +18,12 @@ struct Sprite {
     sdl::Texture* texture = nullptr;
     std::vector<SDL_Rect> frames;
     Clock::duration frameDuration{std::chrono::milliseconds{200}};
+    // Sprites on a higher layer are drawn over everything on lower ones.
+    uint8_t layer = 0;
 };
 
-class Object {
-public:
-    Object() = default;
-    Object(Sprite sprite, const WorldPosition& position);
-
-    [[nodiscard]] const sdl::Texture& texture() const;
-    [[nodiscard]] sdl::Texture& texture();
-    [[nodiscard]] const SDL_Rect& frame() const;
-    [[nodiscard]] const WorldPosition& position() const;
-
-    void moveTo(const WorldPosition& position);
-
-    void update(float delta);
-
-private:
-    Sprite _sprite;
-    WorldPosition _position;
-    Clock::time_point _startTime;
-    Clock::time_point _currentTime;
-};
+// Sprites are registered with the scene once and shared by handle.
+using SpriteId = uint32_t;
 
 class Camera {
 public:
@@ -45,15 +34,20 @@ public:
     restore(const ScreenPosition& screenPosition) const;
 
     void viewport(int x, int y, int w, int h);
+    [[nodiscard]] const ScreenRect& viewport() const;
     void center(float x, float y);
     void pixelsPerUnit(float pixelsPerUnit);
 
     void zoom(float zoom);
     [[nodiscard]] float zoom() const;
 
-private:
+    // The part of the world covered by the viewport, widened by margin screen
+    // pixels on every side.
+    [[nodiscard]] WorldRect visibleArea(float margin = 0.f) const;
+
     [[nodiscard]] float screenPixelsPerUnit() const;
 
+private:
     ScreenRect _viewport;
     WorldPosition _center;
     float _pixelsPerUnit = 1.f;
@@ -62,15 +56,55 @@ private:
 
 class Scene {
 public:
-    void addObject(size_t id, Sprite sprite, WorldPosition position);
-    void moveObject(size_t id, const WorldPosition& position);
-    void killObject(size_t id);
+    // In world units.
+    static constexpr float GridCellSize = 4.f;
+
+    SpriteId addSprite(Sprite sprite);
+
+    void addObject(Entity entity, SpriteId sprite, WorldPosition position);
+    // The position is where the object stands. Height lifts it on the screen
+    // without changing its depth.
+    void moveObject(
+        Entity entity, const WorldPosition& position, float height = 0.f);
+    void killObject(Entity entity);
     void update(float delta);
     void render(sdl::Renderer& renderer);
 
     Camera& camera();
 
 private:
-    std::map<size_t, Object> _objects;
+    [[nodiscard]] SparseIndex::Slot slot(Entity entity) const;
+    [[nodiscard]] const SDL_Rect& frame(SparseIndex::Slot slot) const;
+    void remove(SparseIndex::Slot slot);
+
+    std::vector<Sprite> _sprites;
+    // Small ids of the sprites' textures, used to group draws by atlas.
+    std::vector<uint8_t> _spriteAtlases;
+    std::vector<const sdl::Texture*> _atlases;
+
+    // Objects are packed into parallel arrays, one per field, and found
+    // through their entity index.
+    SparseIndex _slots;
+    std::vector<Entity> _entities;
+    std::vector<SpriteId> _spriteIds;
+    std::vector<WorldPosition> _positions;
+    std::vector<float> _heights;
+    std::vector<Clock::duration> _startTimes;
+    // Animations are timed against the scene's own clock, so update() does
+    // not touch the objects.
+    Clock::duration _time{};
+
+    // Entity indices bucketed by object position, so that render only visits
+    // what is around the camera.
+    SpatialGrid _grid{GridCellSize};
+    // The largest sprite side seen so far, in sprite pixels. Objects are
+    // centered on their positions, so this bounds how far off the visible
+    // area an object may still be seen.
+    int _maxSpriteSize = 0;
+    // The largest height seen so far. Objects are indexed where they stand,
+    // but drawn lifted by their height.
+    float _maxHeight = 0.f;
+    RenderQueue _queue;
     Camera _camera;
+    sdl::SpriteBatch _batch;
 };
@@ -0,0 +1,101 @@
+#include "scheduler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
+
+void Scheduler::add(System system)
+{
+    auto index = _systems.size();
+    _dependents.emplace_back();
+    _dependencyCounts.push_back(0);
+    for (size_t i = 0; i < index; i++) {
+        if (conflict(_systems.at(i), system)) {
+            _dependents.at(i).push_back(index);
+            _dependencyCounts.at(index)++;
+        }
+    }
+    _systems.push_back(std::move(system));
+}
+
+void Scheduler::run(ThreadPool& pool, float delta)
+{
+    auto remaining = std::atomic<size_t>{_systems.size()};
+    auto dependencyCounts =
+        std::make_unique<std::atomic<size_t>[]>(_systems.size());
+    for (size_t i = 0; i < _systems.size(); i++) {
+        dependencyCounts[i] = _dependencyCounts.at(i);
+    }
+
+    auto error = std::exception_ptr{};
+    auto errorMutex = std::mutex{};
+
+    // A finished system runs the first dependent it releases right away on
+    // the same thread, so a chain of conflicting systems costs no trips
+    // through the pool. Only the other released systems are submitted.
+    auto none = _systems.size();
+    auto runChain = [&](auto& self, size_t index) -> void {
+        while (true) {
+            try {
+                _systems.at(index).run(delta);
+            } catch (...) {
+                auto lock = std::scoped_lock{errorMutex};
+                error = std::current_exception();
+            }
+
+            auto next = none;
+            for (auto dependent : _dependents.at(index)) {
+                if (--dependencyCounts[dependent] > 0) {
+                    continue;
+                }
+                if (next == none) {
+                    next = dependent;
+                } else {
+                    pool.submit([&self, dependent] { self(self, dependent); });
+                }
+            }
+            // The last decrement may let run() return, so nothing on its
+            // stack is touched afterwards.
+            if (next == none) {
+                remaining--;
+                return;
+            }
+            remaining--;
+            index = next;
+        }
+    };
+
+    auto first = none;
+    for (size_t i = 0; i < _systems.size(); i++) {
+        if (_dependencyCounts.at(i) > 0) {
+            continue;
+        }
+        if (first == none) {
+            first = i;
+        } else {
+            pool.submit([&runChain, i] { runChain(runChain, i); });
+        }
+    }
+    if (first != none) {
+        runChain(runChain, first);
+    }
+    pool.wait(remaining);
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+bool Scheduler::conflict(const System& lhs, const System& rhs)
+{
+    auto intersects = [](const std::vector<ComponentId>& a,
+                         const std::vector<ComponentId>& b) {
+        return std::ranges::any_of(a, [&b](ComponentId id) {
+            return std::ranges::find(b, id) != b.end();
+        });
+    };
+    return intersects(lhs.writes, rhs.writes) ||
+        intersects(lhs.writes, rhs.reads) || intersects(lhs.reads, rhs.writes);
+}
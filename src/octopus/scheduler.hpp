@@ -0,0 +1,52 @@
+#pragma once
+
+#include "component-id.hpp"
+#include "thread-pool.hpp"
+
+#include <functional>
+#include <string>
+#include <tuple>
+#include <vector>
+
+template <class... Components>
+std::vector<ComponentId> componentIds()
+{
+    return {componentId<Components>()...};
+}
+
+// Runs systems on a thread pool. Each system declares the components it reads
+// and writes; two systems conflict if either one writes something the other
+// touches, and conflicting systems run in the order they were added. All
+// other systems may run concurrently.
+class Scheduler {
+public:
+    struct System {
+        std::string name;
+        std::vector<ComponentId> reads;
+        std::vector<ComponentId> writes;
+        std::function<void(float delta)> run;
+    };
+
+    void add(System system);
+    void run(ThreadPool& pool, float delta);
+
+private:
+    static bool conflict(const System& lhs, const System& rhs);
+
+    std::vector<System> _systems;
+    std::vector<std::vector<size_t>> _dependents;
+    std::vector<size_t> _dependencyCounts;
+};
+
+// Splits a view into ranges of grainSize entities and calls
+// function(entity, components...) for each of them on the pool.
+template <class View, class Function>
+void parallelEach(
+    ThreadPool& pool, const View& view, size_t grainSize, Function&& function)
+{
+    pool.parallelFor(view.size(), grainSize, [&](size_t begin, size_t end) {
+        for (auto&& value : view.slice(begin, end)) {
+            std::apply(function, value);
+        }
+    });
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "entity.hpp"
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+// Maps entity indices to dense slots. Pages are allocated lazily, so sparse id
+// ranges cost nothing, and a lookup is two dependent loads with no branching
+// on tree nodes.
+class SparseIndex {
+public:
+    using Slot = uint32_t;
+
+    static constexpr Slot npos = std::numeric_limits<Slot>::max();
+
+    [[nodiscard]] Slot find(Entity::ValueType index) const
+    {
+        auto pageIndex = index / PageSize;
+        if (pageIndex >= _pages.size() || !_pages[pageIndex]) {
+            return npos;
+        }
+        return (*_pages[pageIndex])[index % PageSize];
+    }
+
+    void set(Entity::ValueType index, Slot slot)
+    {
+        auto pageIndex = index / PageSize;
+        if (pageIndex >= _pages.size()) {
+            _pages.resize(pageIndex + 1);
+        }
+        if (!_pages[pageIndex]) {
+            _pages[pageIndex] = std::make_unique<Page>();
+            _pages[pageIndex]->fill(npos);
+        }
+        (*_pages[pageIndex])[index % PageSize] = slot;
+    }
+
+    void erase(Entity::ValueType index)
+    {
+        auto pageIndex = index / PageSize;
+        if (pageIndex < _pages.size() && _pages[pageIndex]) {
+            (*_pages[pageIndex])[index % PageSize] = npos;
+        }
+    }
+
+private:
+    static constexpr size_t PageSize = 4096;
+    using Page = std::array<Slot, PageSize>;
+
+    std::vector<std::unique_ptr<Page>> _pages;
+};
@@ -0,0 +1,540 @@
+#pragma once
+
+#include "commands.hpp"
+#include "component-id.hpp"
+#include "entity.hpp"
+#include "sparse-index.hpp"
+#include "stable-storage.hpp"
+#include "tick.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class AbstractComponentStorage {
+public:
+    virtual ~AbstractComponentStorage() = default;
+
+    virtual void kill(Entity entity) = 0;
+
+    // Removes the components of those entities that have one here, ignoring
+    // the rest.
+    virtual void killMany(std::span<const Entity> entities) = 0;
+};
+
+template <class Component>
+class ComponentStorage : public AbstractComponentStorage {
+public:
+    using Span = std::conditional_t<
+        stableStorage<Component>,
+        PointerSpan<Component>,
+        std::span<Component>>;
+    using ConstSpan = std::conditional_t<
+        stableStorage<Component>,
+        PointerSpan<const Component>,
+        std::span<const Component>>;
+
+    [[nodiscard]] bool contains(Entity entity) const
+    {
+        auto slot = _index.find(entity.index());
+        return slot != SparseIndex::npos && _entities[slot] == entity;
+    }
+
+    Component* find(Entity entity)
+    {
+        auto slot = _index.find(entity.index());
+        if (slot == SparseIndex::npos || _entities[slot] != entity) {
+            return nullptr;
+        }
+        return &_components[slot];
+    }
+
+    Component& component(Entity entity)
+    {
+        return _components[slot(entity)];
+    }
+
+    const Component& component(Entity entity) const
+    {
+        return _components[slot(entity)];
+    }
+
+    Span components()
+    {
+        if constexpr (stableStorage<Component>) {
+            return _components.span();
+        } else {
+            return _components;
+        }
+    }
+
+    ConstSpan components() const
+    {
+        if constexpr (stableStorage<Component>) {
+            return _components.span();
+        } else {
+            return _components;
+        }
+    }
+
+    std::span<const Entity> entities() const
+    {
+        return _entities;
+    }
+
+    Component& add(Entity entity, const Component& component, Tick tick = 0)
+    {
+        link(entity, tick);
+        _components.push_back(component);
+        return _components.back();
+    }
+
+    Component& add(Entity entity, Component&& component, Tick tick = 0)
+    {
+        link(entity, tick);
+        _components.push_back(std::move(component));
+        return _components.back();
+    }
+
+    template <class... Args>
+    Component& emplace(Entity entity, Tick tick, Args&&... args)
+    {
+        link(entity, tick);
+        return _components.emplace_back(std::forward<Args>(args)...);
+    }
+
+    // Stamps the entity's component as changed in the given tick. Different
+    // entities may be marked concurrently.
+    void markChanged(Entity entity, Tick tick)
+    {
+        _ticks[slot(entity)] = tick;
+    }
+
+    // Calls function(entity, component) for every component last changed in
+    // or after the given tick.
+    template <class Function>
+    void eachChanged(Tick since, Function&& function)
+    {
+        for (size_t i = 0; i < _ticks.size(); i++) {
+            if (_ticks[i] >= since) {
+                function(_entities[i], _components[i]);
+            }
+        }
+    }
+
+    void kill(Entity entity) override
+    {
+        remove(entity, slot(entity));
+    }
+
+    void killMany(std::span<const Entity> entities) override
+    {
+        for (auto entity : entities) {
+            auto slot = _index.find(entity.index());
+            if (slot != SparseIndex::npos && _entities[slot] == entity) {
+                remove(entity, slot);
+            }
+        }
+    }
+
+private:
+    void remove(Entity entity, SparseIndex::Slot slot)
+    {
+        if (slot + 1 < _entities.size()) {
+            _entities[slot] = _entities.back();
+            if constexpr (stableStorage<Component>) {
+                _components.swapWithLast(slot);
+            } else {
+                _components[slot] = std::move(_components.back());
+            }
+            _ticks[slot] = _ticks.back();
+            _index.set(_entities[slot].index(), slot);
+        }
+        _entities.pop_back();
+        _components.pop_back();
+        _ticks.pop_back();
+        _index.erase(entity.index());
+    }
+
+    void link(Entity entity, Tick tick)
+    {
+        _index.set(
+            entity.index(), static_cast<SparseIndex::Slot>(_entities.size()));
+        _entities.push_back(entity);
+        _ticks.push_back(tick);
+    }
+
+    SparseIndex::Slot slot(Entity entity) const
+    {
+        auto slot = _index.find(entity.index());
+        if (slot == SparseIndex::npos || _entities[slot] != entity) {
+            throw std::out_of_range{"ComponentStorage: unknown entity"};
+        }
+        return slot;
+    }
+
+    std::vector<Entity> _entities;
+    std::conditional_t<
+        stableStorage<Component>,
+        StableArray<Component>,
+        std::vector<Component>>
+        _components;
+    std::vector<Tick> _ticks;
+    SparseIndex _index;
+};
+
+// Iterates entities that have all of the given components, yielding
+// (entity, components...) tuples. Iteration is driven by the smallest storage,
+// and the remaining components are fetched through their sparse indices.
+template <class... Components>
+class View {
+public:
+    using Value = std::tuple<Entity, Components&...>;
+
+    explicit View(ComponentStorage<Components>*... storages)
+        : _storages(storages...)
+    {
+        if ((storages && ...)) {
+            _entities = std::min(
+                {storages->entities()...},
+                [](const auto& lhs, const auto& rhs) {
+                    return lhs.size() < rhs.size();
+                });
+        }
+    }
+
+    class Iterator {
+    public:
+        Iterator(const View* view, size_t position)
+            : _view(view)
+            , _position(position)
+        {
+            skipMismatches();
+        }
+
+        Value operator*() const
+        {
+            return std::apply(
+                [this](Components*... components) {
+                    return Value{_view->_entities[_position], *components...};
+                },
+                _current);
+        }
+
+        Iterator& operator++()
+        {
+            _position++;
+            skipMismatches();
+            return *this;
+        }
+
+        bool operator==(const Iterator& other) const
+        {
+            return _position == other._position;
+        }
+
+    private:
+        void skipMismatches()
+        {
+            for (; _position < _view->_entities.size(); _position++) {
+                auto entity = _view->_entities[_position];
+                _current = std::apply(
+                    [entity](ComponentStorage<Components>*... storages) {
+                        return std::tuple{storages->find(entity)...};
+                    },
+                    _view->_storages);
+                if (std::apply(
+                        [](Components*... components) {
+                            return (components && ...);
+                        },
+                        _current)) {
+                    break;
+                }
+            }
+        }
+
+        const View* _view = nullptr;
+        size_t _position = 0;
+        std::tuple<Components*...> _current;
+    };
+
+    Iterator begin() const
+    {
+        return Iterator{this, 0};
+    }
+
+    Iterator end() const
+    {
+        return Iterator{this, _entities.size()};
+    }
+
+    // Number of candidate entities, not all of which necessarily match.
+    [[nodiscard]] size_t size() const
+    {
+        return _entities.size();
+    }
+
+    [[nodiscard]] View slice(size_t begin, size_t end) const
+    {
+        auto view = *this;
+        view._entities = _entities.subspan(begin, end - begin);
+        return view;
+    }
+
+private:
+    std::tuple<ComponentStorage<Components>*...> _storages;
+    std::span<const Entity> _entities;
+};
+
+// A single component needs no matching at all: walk the dense arrays in
+// lockstep.
+template <class Component>
+class View<Component> {
+public:
+    using Value = std::tuple<Entity, Component&>;
+
+    explicit View(ComponentStorage<Component>* storage)
+    {
+        if (storage) {
+            _entities = storage->entities();
+            _components = storage->components();
+        }
+    }
+
+    class Iterator {
+    public:
+        Iterator(const View* view, size_t position)
+            : _view(view)
+            , _position(position)
+        { }
+
+        Value operator*() const
+        {
+            return Value{
+                _view->_entities[_position], _view->_components[_position]};
+        }
+
+        Iterator& operator++()
+        {
+            _position++;
+            return *this;
+        }
+
+        bool operator==(const Iterator& other) const
+        {
+            return _position == other._position;
+        }
+
+    private:
+        const View* _view = nullptr;
+        size_t _position = 0;
+    };
+
+    Iterator begin() const
+    {
+        return Iterator{this, 0};
+    }
+
+    Iterator end() const
+    {
+        return Iterator{this, _entities.size()};
+    }
+
+    [[nodiscard]] size_t size() const
+    {
+        return _entities.size();
+    }
+
+    [[nodiscard]] View slice(size_t begin, size_t end) const
+    {
+        auto view = *this;
+        view._entities = _entities.subspan(begin, end - begin);
+        view._components = _components.subspan(begin, end - begin);
+        return view;
+    }
+
+private:
+    std::span<const Entity> _entities;
+    typename ComponentStorage<Component>::Span _components;
+};
+
+class SparseSetEcs {
+public:
+    template <class Component>
+    Component& component(Entity entity)
+    {
+        return existingStorage<Component>().component(entity);
+    }
+
+    template <class Component>
+    const Component& component(Entity entity) const
+    {
+        return existingStorage<Component>().component(entity);
+    }
+
+    template <class Component>
+    typename ComponentStorage<Component>::Span components()
+    {
+        return existingStorage<Component>().components();
+    }
+
+    template <class Component>
+    typename ComponentStorage<Component>::ConstSpan components() const
+    {
+        return existingStorage<Component>().components();
+    }
+
+    template <class Component>
+    std::span<const Entity> entities() const
+    {
+        return existingStorage<Component>().entities();
+    }
+
+    template <class... Components>
+    View<Components...> view()
+    {
+        return View<Components...>{findStorage<Components>()...};
+    }
+
+    template <class Component>
+    std::remove_cvref_t<Component>& add(Entity entity, Component&& component)
+    {
+        using Type = std::remove_cvref_t<Component>;
+        return storage<Type>().add(
+            entity, std::forward<Component>(component), _tick);
+    }
+
+    template <class Component, class... Args>
+    Component& emplace(Entity entity, Args&&... args)
+    {
+        return storage<Component>().emplace(
+            entity, _tick, std::forward<Args>(args)...);
+    }
+
+    // The tick currently being simulated. Every flush() starts a new one.
+    [[nodiscard]] Tick tick() const
+    {
+        return _tick;
+    }
+
+    // Records that a system modified the entity's component. Adding a
+    // component counts as a change too.
+    template <class Component>
+    void markChanged(Entity entity)
+    {
+        existingStorage<Component>().markChanged(entity, _tick);
+    }
+
+    // Calls function(entity, component) for every component of the type that
+    // changed in or after the given tick.
+    template <class Component, class Function>
+    void eachChanged(Tick since, Function&& function)
+    {
+        if (auto* storage = findStorage<Component>()) {
+            storage->eachChanged(since, std::forward<Function>(function));
+        }
+    }
+
+    Entity create()
+    {
+        return _entityPool.create();
+    }
+
+    Entity reserve()
+    {
+        return _entityPool.reserve();
+    }
+
+    [[nodiscard]] bool alive(Entity entity) const
+    {
+        return _entityPool.alive(entity);
+    }
+
+    void kill(Entity entity)
+    {
+        if (!_entityPool.alive(entity)) {
+            throw std::out_of_range{"SparseSetEcs: entity is not alive"};
+        }
+        killMany({&entity, 1});
+    }
+
+    // Kills every live entity in the list; dead or repeated handles are
+    // skipped. Each storage drops its components in one pass, and nothing is
+    // erased from node-based containers or reallocated.
+    void killMany(std::span<const Entity> entities)
+    {
+        for (const auto& storage : _storages) {
+            if (storage) {
+                storage->killMany(entities);
+            }
+        }
+        for (auto entity : entities) {
+            if (_entityPool.alive(entity)) {
+                _entityPool.kill(entity);
+            }
+        }
+    }
+
+    // The calling thread's command buffer. Recorded changes are applied by
+    // flush(), which must not overlap with any system.
+    CommandBuffer<SparseSetEcs>& commands()
+    {
+        return _commands.local(*this);
+    }
+
+    void flush()
+    {
+        _entityPool.commitReserved();
+        _commands.apply(*this);
+        _tick++;
+    }
+
+private:
+    template <class Component>
+    ComponentStorage<Component>& existingStorage()
+    {
+        if (auto* storage = findStorage<Component>()) {
+            return *storage;
+        }
+        throw std::out_of_range{"SparseSetEcs: no such component storage"};
+    }
+
+    template <class Component>
+    const ComponentStorage<Component>& existingStorage() const
+    {
+        return const_cast<SparseSetEcs*>(this)->existingStorage<Component>();
+    }
+
+    template <class Component>
+    ComponentStorage<Component>* findStorage()
+    {
+        auto id = componentId<Component>();
+        if (id >= _storages.size()) {
+            return nullptr;
+        }
+        return static_cast<ComponentStorage<Component>*>(_storages[id].get());
+    }
+
+    template <class Component>
+    ComponentStorage<Component>& storage()
+    {
+        auto id = componentId<Component>();
+        if (id >= _storages.size()) {
+            _storages.resize(id + 1);
+        }
+        if (!_storages[id]) {
+            _storages[id] = std::make_unique<ComponentStorage<Component>>();
+        }
+        return static_cast<ComponentStorage<Component>&>(*_storages[id]);
+    }
+
+    EntityPool _entityPool;
+    std::vector<std::unique_ptr<AbstractComponentStorage>> _storages;
+    CommandBuffers<SparseSetEcs> _commands;
+    Tick _tick = 1;
+};
@@ -0,0 +1,51 @@
+#include "spatial-grid.hpp"
+
+SpatialGrid::SpatialGrid(float cellSize)
+    : _cellSize(cellSize)
+{ }
+
+void SpatialGrid::insert(size_t id, const WorldPosition& position)
+{
+    link(id, cellKey(cellOf(position)));
+}
+
+void SpatialGrid::move(size_t id, const WorldPosition& position)
+{
+    auto entry = _entries.at(id);
+    auto cell = cellKey(cellOf(position));
+    if (cell != entry.cell) {
+        unlink(entry);
+        link(id, cell);
+    }
+}
+
+void SpatialGrid::erase(size_t id)
+{
+    unlink(_entries.at(id));
+}
+
+void SpatialGrid::link(size_t id, uint64_t cell)
+{
+    auto& ids = _cells[cell];
+    if (id >= _entries.size()) {
+        _entries.resize(id + 1);
+    }
+    _entries[id] = Entry{.cell = cell, .slot = ids.size()};
+    ids.push_back(id);
+}
+
+void SpatialGrid::unlink(const Entry& entry)
+{
+    auto it = _cells.find(entry.cell);
+    auto& ids = it->second;
+    if (entry.slot + 1 < ids.size()) {
+        ids[entry.slot] = ids.back();
+        _entries.at(ids[entry.slot]).slot = entry.slot;
+    }
+    ids.pop_back();
+
+    // Empty cells are dropped, so that memory follows the occupied area.
+    if (ids.empty()) {
+        _cells.erase(it);
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "geometry.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Buckets object ids into square cells of a fixed size, so that an area query
+// only visits the cells the area overlaps. Cells are created on demand, which
+// keeps huge, mostly empty worlds cheap. Ids index a flat table, so they
+// should be small and dense, such as entity indices.
+class SpatialGrid {
+public:
+    explicit SpatialGrid(float cellSize);
+
+    void insert(size_t id, const WorldPosition& position);
+    // Only touches the cells when the object crosses into another one.
+    void move(size_t id, const WorldPosition& position);
+    void erase(size_t id);
+
+    // Calls function(id) for every object in the cells overlapping the area.
+    // Objects near the area's border may lie outside of it.
+    template <class Function>
+    void query(const WorldRect& area, Function&& function) const
+    {
+        auto [minX, minY] = cellOf({area.x, area.y});
+        auto [maxX, maxY] = cellOf({area.x + area.w, area.y + area.h});
+        auto cellCount = (static_cast<int64_t>(maxX) - minX + 1) *
+            (static_cast<int64_t>(maxY) - minY + 1);
+
+        // Zoomed far out, walking the non-empty cells is cheaper than probing
+        // every cell of the area.
+        if (cellCount > static_cast<int64_t>(_cells.size())) {
+            for (const auto& [key, ids] : _cells) {
+                auto [x, y] = cellOfKey(key);
+                if (x >= minX && x <= maxX && y >= minY && y <= maxY) {
+                    for (auto id : ids) {
+                        function(id);
+                    }
+                }
+            }
+            return;
+        }
+
+        for (auto y = minY; y <= maxY; y++) {
+            for (auto x = minX; x <= maxX; x++) {
+                auto it = _cells.find(cellKey({x, y}));
+                if (it != _cells.end()) {
+                    for (auto id : it->second) {
+                        function(id);
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    struct Cell {
+        int32_t x = 0;
+        int32_t y = 0;
+    };
+
+    struct Entry {
+        uint64_t cell = 0;
+        size_t slot = 0;
+    };
+
+    [[nodiscard]] Cell cellOf(const WorldPosition& position) const
+    {
+        return Cell{
+            .x = static_cast<int32_t>(std::floor(position.x / _cellSize)),
+            .y = static_cast<int32_t>(std::floor(position.y / _cellSize)),
+        };
+    }
+
+    static uint64_t cellKey(Cell cell)
+    {
+        return (uint64_t{static_cast<uint32_t>(cell.x)} << 32) |
+            static_cast<uint32_t>(cell.y);
+    }
+
+    static Cell cellOfKey(uint64_t key)
+    {
+        return Cell{
+            .x = static_cast<int32_t>(key >> 32),
+            .y = static_cast<int32_t>(key & 0xffff'ffff),
+        };
+    }
+
+    void link(size_t id, uint64_t cell);
+    void unlink(const Entry& entry);
+
+    float _cellSize = 1.f;
+    std::unordered_map<uint64_t, std::vector<size_t>> _cells;
+    std::vector<Entry> _entries;
+};
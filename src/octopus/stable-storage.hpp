@@ -0,0 +1,182 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Components are packed into one array by default. Adding a component may
+// reallocate that array, and killing one moves the last component into the
+// hole. Specialize this to true for types that are referenced across ticks,
+// e.g. by coroutines: their components then keep their address for as long
+// as they exist, at the price of an indirection on iteration. The archetype
+// ECS keeps such components out of its chunks and moves only pointers.
+template <class Component>
+constexpr bool stableStorage = false;
+
+// Hands out fixed-address slots from pages that are only released along with
+// the pool. Freed slots go on an intrusive free list and are reused first.
+template <class T>
+class PagedPool {
+public:
+    PagedPool() = default;
+    PagedPool(const PagedPool&) = delete;
+    PagedPool& operator=(const PagedPool&) = delete;
+
+    template <class... Args>
+    T* create(Args&&... args)
+    {
+        if (!_free) {
+            grow();
+        }
+        auto* slot = _free;
+        _free = slot->next;
+        return new (slot->storage) T(std::forward<Args>(args)...);
+    }
+
+    void destroy(T* object)
+    {
+        object->~T();
+        auto* slot = new (object) Slot;
+        slot->next = _free;
+        _free = slot;
+    }
+
+private:
+    static constexpr size_t PageSize = 256;
+
+    union Slot {
+        Slot* next;
+        alignas(T) std::byte storage[sizeof(T)];
+    };
+
+    using Page = std::array<Slot, PageSize>;
+
+    void grow()
+    {
+        auto& page = *_pages.emplace_back(std::make_unique<Page>());
+        for (auto i = PageSize; i-- > 0;) {
+            page[i].next = _free;
+            _free = &page[i];
+        }
+    }
+
+    std::vector<std::unique_ptr<Page>> _pages;
+    Slot* _free = nullptr;
+};
+
+// A span over components that live behind pointers.
+template <class T>
+class PointerSpan {
+public:
+    using Pointer = std::remove_const_t<T>*;
+
+    PointerSpan() = default;
+
+    explicit PointerSpan(std::span<const Pointer> pointers)
+        : _pointers(pointers)
+    { }
+
+    T& operator[](size_t index) const
+    {
+        return *_pointers[index];
+    }
+
+    [[nodiscard]] size_t size() const
+    {
+        return _pointers.size();
+    }
+
+    [[nodiscard]] PointerSpan subspan(size_t offset, size_t count) const
+    {
+        return PointerSpan{_pointers.subspan(offset, count)};
+    }
+
+private:
+    std::span<const Pointer> _pointers;
+};
+
+// The dense component array of a stable storage: pointers into a paged pool.
+// Mirrors the parts of std::vector that ComponentStorage uses.
+template <class Component>
+class StableArray {
+public:
+    StableArray() = default;
+    StableArray(const StableArray&) = delete;
+    StableArray& operator=(const StableArray&) = delete;
+
+    ~StableArray()
+    {
+        for (auto* component : _pointers) {
+            _pool.destroy(component);
+        }
+    }
+
+    [[nodiscard]] size_t size() const
+    {
+        return _pointers.size();
+    }
+
+    Component& operator[](size_t index)
+    {
+        return *_pointers[index];
+    }
+
+    const Component& operator[](size_t index) const
+    {
+        return *_pointers[index];
+    }
+
+    Component& back()
+    {
+        return *_pointers.back();
+    }
+
+    template <class... Args>
+    Component& emplace_back(Args&&... args)
+    {
+        auto* component = _pool.create(std::forward<Args>(args)...);
+        return *_pointers.emplace_back(component);
+    }
+
+    void push_back(const Component& component)
+    {
+        emplace_back(component);
+    }
+
+    void push_back(Component&& component)
+    {
+        emplace_back(std::move(component));
+    }
+
+    void pop_back()
+    {
+        _pool.destroy(_pointers.back());
+        _pointers.pop_back();
+    }
+
+    // Moves the last component into the slot without moving it in memory; the
+    // component that was in the slot ends up last.
+    void swapWithLast(size_t index)
+    {
+        std::swap(_pointers[index], _pointers.back());
+    }
+
+    PointerSpan<Component> span()
+    {
+        return PointerSpan<Component>{_pointers};
+    }
+
+    PointerSpan<const Component> span() const
+    {
+        return PointerSpan<const Component>{_pointers};
+    }
+
+private:
+    PagedPool<Component> _pool;
+    std::vector<Component*> _pointers;
+};
@@ -1,69 +1,98 @@
 #include "task.hpp"
 
-#include <iostream>
+#include <utility>
 
-bool CoroTask::await_ready()
+CoroTask::CoroTask(std::coroutine_handle<Promise> handle)
+    : _handle(handle)
+{ }
+
+CoroTask::CoroTask(CoroTask&& other) noexcept
+    : _handle(std::exchange(other._handle, nullptr))
+{ }
+
+CoroTask& CoroTask::operator=(CoroTask&& other) noexcept
 {
-    if (handle.done()) {
-        // std::cerr << "destroying coroutine before await: " <<
-        // handle.address() << "\n";
-        handle.destroy();
-        return true;
+    if (this != &other) {
+        if (_handle) {
+            _handle.destroy();
+        }
+        _handle = std::exchange(other._handle, nullptr);
     }
-    return false;
+    return *this;
 }
 
-void CoroTask::await_suspend(std::coroutine_handle<Promise> suspended) const
+CoroTask::~CoroTask()
 {
-    std::cerr << std::format(
-        "{} awaits {}\n",
-        suspended.promise().functionName,
-        handle.promise().functionName);
-
-    std::cerr << std::format(
-        "setting {}'s leaf to {}\n",
-        suspended.promise().root.promise().functionName,
-        handle.promise().leaf.promise().functionName);
-    suspended.promise().root.promise().leaf = this->handle.promise().leaf;
-
-    std::cerr << std::format(
-        "setting {}'s parent to {}\n",
-        handle.promise().functionName,
-        suspended.promise().functionName);
-    handle.promise().parent = suspended;
+    // Destroying a suspended task also destroys the tasks it awaits, which
+    // live in its frame.
+    if (_handle) {
+        _handle.destroy();
+    }
 }
 
-void CoroTask::update(float delta)
+std::coroutine_handle<> CoroTask::await_suspend(
+    std::coroutine_handle<Promise> suspended) const
 {
-    std::cerr << "CoroTask::update\n";
+    trace<TraceLevel::Verbose>(
+        suspended.promise().span, "awaits", _handle.promise().span);
 
-    handle.promise().time += delta;
+    auto& root = *suspended.promise().root;
+    _handle.promise().root = &root;
+    root.stack.push_back(_handle);
+    return _handle;
+}
 
-    auto leaf = handle.promise().leaf;
-    if (leaf.done()) {
-        if (leaf.promise().exception) {
-            std::rethrow_exception(leaf.promise().exception);
-        }
+void CoroTask::await_resume() const
+{
+    if (_handle.promise().exception) {
+        std::rethrow_exception(_handle.promise().exception);
+    }
+}
+
+void CoroTask::resume()
+{
+    auto& promise = _handle.promise();
+    promise.wait = WaitState{};
+
+    auto leaf = promise.stack.empty() ? _handle : promise.stack.back();
+    trace<TraceLevel::Verbose>(leaf.promise().span, "resume");
+    leaf.resume();
 
-        handle.promise().leaf = leaf.promise().parent;
-        std::cerr << "destroying coroutine: " << leaf.address() << "\n";
-        leaf.destroy();
+    if (_handle.done() && promise.exception) {
+        std::rethrow_exception(promise.exception);
     }
+}
 
-    std::cerr << "resuming leaf: "
-              << handle.promise().leaf.promise().functionName << "\n";
-    handle.promise().leaf.resume();
+bool CoroTask::done() const
+{
+    return _handle.done();
 }
 
-CoroTask Promise::get_return_object()
+const WaitState& CoroTask::wait() const
 {
-    auto currentHandle = std::coroutine_handle<Promise>::from_promise(*this);
+    return _handle.promise().wait;
+}
 
-    // std::cerr << "created coroutine: " << currentHandle.address() << "\n";
+std::coroutine_handle<> Promise::FinalAwaiter::await_suspend(
+    std::coroutine_handle<Promise> finished) const noexcept
+{
+    auto& root = *finished.promise().root;
+    if (&root == &finished.promise()) {
+        return std::noop_coroutine();
+    }
 
-    root = currentHandle;
-    leaf = currentHandle;
-    return CoroTask{.handle = currentHandle};
+    // The parent is resumed right away, and destroys this frame once it is
+    // done with the awaited task.
+    root.stack.pop_back();
+    if (root.stack.empty()) {
+        return std::coroutine_handle<Promise>::from_promise(root);
+    }
+    return root.stack.back();
+}
+
+CoroTask Promise::get_return_object()
+{
+    return CoroTask{std::coroutine_handle<Promise>::from_promise(*this)};
 }
 
 void Promise::unhandled_exception()
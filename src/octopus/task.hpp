@@ -1,41 +1,123 @@
 #pragma once
 
+#include "frame-pool.hpp"
+#include "trace.hpp"
+
 #include <chrono>
+#include <concepts>
 #include <coroutine>
 #include <exception>
-#include <string>
+#include <limits>
+#include <string_view>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 struct Promise;
 
-struct CoroTask {
+// Polled by the scheduler while a task waits on it.
+class WaitCondition {
+public:
+    [[nodiscard]] virtual bool ready() const = 0;
+
+protected:
+    ~WaitCondition() = default;
+};
+
+// What a suspended task is waiting for. Set on the root promise by the
+// awaitables below and consumed by whoever resumes the task; a plain
+// suspension means the next tick.
+struct WaitState {
+    enum class Kind {
+        NextTick,
+        Duration,
+        Condition,
+    };
+
+    Kind kind = Kind::NextTick;
+    // The duration to wait for. For the next tick: how long the task's last
+    // decision stays valid, should the scheduler want to skip ticks.
+    float seconds = 0.f;
+    const WaitCondition* condition = nullptr;
+};
+
+// Owns a coroutine frame. Tasks start lazily: a root task runs on its first
+// resume(), and an awaited task runs as soon as it is awaited.
+class CoroTask {
+public:
     using promise_type = Promise;
 
-    bool await_ready();
-    void await_suspend(std::coroutine_handle<Promise> suspended) const;
-    void await_resume() { }
+    CoroTask() = default;
+    explicit CoroTask(std::coroutine_handle<Promise> handle);
+    CoroTask(const CoroTask&) = delete;
+    CoroTask(CoroTask&& other) noexcept;
+    CoroTask& operator=(const CoroTask&) = delete;
+    CoroTask& operator=(CoroTask&& other) noexcept;
+    ~CoroTask();
 
-    void update(float delta);
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    std::coroutine_handle<> await_suspend(
+        std::coroutine_handle<Promise> suspended) const;
+    void await_resume() const;
+
+    // Resumes the innermost task the root is waiting on. Tasks finishing
+    // along the way hand control straight back to their parents.
+    void resume();
+
+    [[nodiscard]] bool done() const;
+    [[nodiscard]] const WaitState& wait() const;
 
-    std::coroutine_handle<Promise> handle;
+private:
+    std::coroutine_handle<Promise> _handle;
 };
 
 struct Promise {
+    // Hands control back to the awaiting task, if there is one.
+    struct FinalAwaiter {
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        std::coroutine_handle<> await_suspend(
+            std::coroutine_handle<Promise> finished) const noexcept;
+
+        void await_resume() const noexcept { }
+    };
+
     template <class... Args>
-    explicit Promise(std::string functionName, Args&&...)
-        : functionName(std::move(functionName))
-    { }
+    explicit Promise(std::string_view functionName, Args&&...)
+        : functionName(functionName)
+    {
+        trace<TraceLevel::Debug>(span, functionName);
+    }
+
+    // Frames come from a pool, so that starting an action does not hit the
+    // heap once the pool has warmed up.
+    static void* operator new(size_t size)
+    {
+        return allocateFrame(size);
+    }
+
+    static void operator delete(void* frame, size_t size)
+    {
+        deallocateFrame(frame, size);
+    }
 
     CoroTask get_return_object();
 
-    std::suspend_never initial_suspend() noexcept
+    std::suspend_always initial_suspend() noexcept
     {
         return {};
     };
 
-    std::suspend_always final_suspend() noexcept
+    FinalAwaiter final_suspend() noexcept
     {
+        trace<TraceLevel::Debug>(span, "finish");
         return {};
     };
 
@@ -44,9 +126,108 @@ struct Promise {
 
     std::exception_ptr exception;
 
-    std::coroutine_handle<Promise> root;
-    std::coroutine_handle<Promise> leaf;
-    std::coroutine_handle<Promise> parent;
-    float time = 0.f;
-    std::string functionName;
+    // The outermost task this one runs under; itself for a root task.
+    Promise* root = this;
+    // Root only: the awaited tasks, innermost last.
+    std::vector<std::coroutine_handle<Promise>> stack;
+    std::string_view functionName;
+    SpanId span = traceSpan();
+    WaitState wait;
+};
+
+// A task that set something in motion, such as a velocity, should say when
+// it has to look again, e.g. on arrival; it is never left waiting longer.
+struct NextTick {
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<Promise> suspended) const noexcept
+    {
+        suspended.promise().root->wait = WaitState{
+            .kind = WaitState::Kind::NextTick,
+            .seconds = validFor,
+        };
+    }
+
+    void await_resume() const noexcept { }
+
+    float validFor = std::numeric_limits<float>::infinity();
+};
+
+struct WaitFor {
+    explicit WaitFor(std::chrono::duration<float> duration)
+        : duration(duration)
+    { }
+
+    bool await_ready() const noexcept
+    {
+        return duration.count() <= 0.f;
+    }
+
+    void await_suspend(std::coroutine_handle<Promise> suspended) const noexcept
+    {
+        suspended.promise().root->wait = WaitState{
+            .kind = WaitState::Kind::Duration,
+            .seconds = duration.count(),
+        };
+    }
+
+    void await_resume() const noexcept { }
+
+    std::chrono::duration<float> duration;
+};
+
+// Suspends until the predicate holds. The awaiter lives in the coroutine
+// frame while the task waits, so the scheduler can poll it in place.
+template <std::predicate Predicate>
+struct WaitUntil : WaitCondition {
+    explicit WaitUntil(Predicate predicate)
+        : predicate(std::move(predicate))
+    { }
+
+    [[nodiscard]] bool ready() const override
+    {
+        return predicate();
+    }
+
+    bool await_ready() const
+    {
+        return predicate();
+    }
+
+    void await_suspend(std::coroutine_handle<Promise> suspended) const noexcept
+    {
+        suspended.promise().root->wait = WaitState{
+            .kind = WaitState::Kind::Condition,
+            .condition = this,
+        };
+    }
+
+    void await_resume() const noexcept { }
+
+    Predicate predicate;
+};
+
+// Awaiting this yields the trace span of the awaiting coroutine, without
+// suspending it.
+struct CurrentSpan {
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    bool await_suspend(std::coroutine_handle<Promise> suspended) noexcept
+    {
+        span = suspended.promise().span;
+        return false;
+    }
+
+    SpanId await_resume() const noexcept
+    {
+        return span;
+    }
+
+    SpanId span = 0;
 };
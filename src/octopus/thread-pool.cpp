@@ -0,0 +1,136 @@
+#include "thread-pool.hpp"
+
+namespace {
+
+thread_local const ThreadPool* currentPool = nullptr;
+thread_local size_t currentQueueIndex = 0;
+
+} // namespace
+
+ThreadPool::ThreadPool(size_t workerCount)
+{
+    for (size_t i = 0; i <= workerCount; i++) {
+        _queues.push_back(std::make_unique<Queue>());
+    }
+
+    _workers.reserve(workerCount);
+    for (size_t i = 0; i < workerCount; i++) {
+        _workers.emplace_back([this, i](const std::stop_token& stopToken) {
+            currentPool = this;
+            currentQueueIndex = i;
+            work(i, stopToken);
+        });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    for (auto& worker : _workers) {
+        worker.request_stop();
+    }
+    _workers.clear();
+}
+
+size_t ThreadPool::workerCount() const
+{
+    return _workers.size();
+}
+
+void ThreadPool::submit(Task task)
+{
+    {
+        auto& queue = *_queues.at(currentQueue());
+        auto lock = std::scoped_lock{queue.mutex};
+        queue.tasks.push_back(std::move(task));
+    }
+    _queuedTasks++;
+
+    // Synchronize with workers that are about to fall asleep, so the wakeup
+    // is not lost between their check and their wait.
+    { auto lock = std::scoped_lock{_sleepMutex}; }
+    _wakeUp.notify_one();
+    notifyWaiters();
+}
+
+void ThreadPool::wait(const std::atomic<size_t>& remaining)
+{
+    auto queueIndex = currentQueue();
+    while (remaining > 0) {
+        if (tryRunTask(queueIndex)) {
+            continue;
+        }
+
+        // Nothing to help with: sleep until a task finishes or a new one is
+        // queued.
+        auto lock = std::unique_lock{_sleepMutex};
+        _waiters++;
+        _progress.wait(lock, [this, &remaining] {
+            return remaining == 0 || _queuedTasks > 0;
+        });
+        _waiters--;
+    }
+}
+
+size_t ThreadPool::defaultWorkerCount()
+{
+    return std::max(std::thread::hardware_concurrency(), 1u) - 1;
+}
+
+void ThreadPool::work(size_t queueIndex, const std::stop_token& stopToken)
+{
+    while (!stopToken.stop_requested()) {
+        if (!tryRunTask(queueIndex)) {
+            auto lock = std::unique_lock{_sleepMutex};
+            _wakeUp.wait(lock, stopToken, [this] { return _queuedTasks > 0; });
+        }
+    }
+}
+
+bool ThreadPool::tryRunTask(size_t queueIndex)
+{
+    auto task = Task{};
+
+    {
+        auto& own = *_queues.at(queueIndex);
+        auto lock = std::scoped_lock{own.mutex};
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+        }
+    }
+
+    for (size_t i = 1; !task && i < _queues.size(); i++) {
+        auto& victim = *_queues.at((queueIndex + i) % _queues.size());
+        auto lock = std::scoped_lock{victim.mutex};
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+        }
+    }
+
+    if (!task) {
+        return false;
+    }
+    _queuedTasks--;
+    task();
+    notifyWaiters();
+    return true;
+}
+
+void ThreadPool::notifyWaiters()
+{
+    // Cheap when nobody waits, which is the common case for workers.
+    if (_waiters > 0) {
+        { auto lock = std::scoped_lock{_sleepMutex}; }
+        _progress.notify_all();
+    }
+}
+
+size_t ThreadPool::currentQueue() const
+{
+    if (currentPool == this) {
+        return currentQueueIndex;
+    }
+    // Threads outside the pool share the last queue.
+    return _queues.size() - 1;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A work-stealing thread pool. Every worker owns a task deque: it pops its
+// own tasks from the back and steals from the front of the others when it
+// runs dry. Threads that wait for tasks to finish help execute them instead
+// of blocking, so waiting from inside a task cannot deadlock the pool.
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+
+    explicit ThreadPool(size_t workerCount = defaultWorkerCount());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool(ThreadPool&&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ThreadPool& operator=(ThreadPool&&) = delete;
+
+    [[nodiscard]] size_t workerCount() const;
+
+    void submit(Task task);
+
+    // Runs queued tasks on the calling thread until the counter drops to zero.
+    // Sleeps while there is nothing to run; the counter must be decremented
+    // from inside a task of this pool.
+    void wait(const std::atomic<size_t>& remaining);
+
+    // Calls function(begin, end) for consecutive ranges of at most grainSize
+    // indices covering [0, count), and returns once all of them are done.
+    template <class Function>
+    void parallelFor(size_t count, size_t grainSize, Function&& function)
+    {
+        if (count == 0) {
+            return;
+        }
+        grainSize = std::max<size_t>(grainSize, 1);
+        auto chunkCount = (count + grainSize - 1) / grainSize;
+        if (chunkCount == 1 || _workers.empty()) {
+            function(size_t{0}, count);
+            return;
+        }
+
+        auto remaining = std::atomic<size_t>{chunkCount};
+        auto error = std::exception_ptr{};
+        auto errorMutex = std::mutex{};
+        for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+            submit([&, chunk] {
+                try {
+                    auto begin = chunk * grainSize;
+                    function(begin, std::min(begin + grainSize, count));
+                } catch (...) {
+                    auto lock = std::scoped_lock{errorMutex};
+                    error = std::current_exception();
+                }
+                remaining--;
+            });
+        }
+        wait(remaining);
+
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    static size_t defaultWorkerCount();
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void work(size_t queueIndex, const std::stop_token& stopToken);
+    bool tryRunTask(size_t queueIndex);
+    void notifyWaiters();
+    size_t currentQueue() const;
+
+    std::vector<std::unique_ptr<Queue>> _queues;
+    std::atomic<size_t> _queuedTasks = 0;
+    std::mutex _sleepMutex;
+    std::condition_variable_any _wakeUp;
+    // Threads inside wait() sleep on this one, as they wake up for finished
+    // tasks too.
+    std::atomic<size_t> _waiters = 0;
+    std::condition_variable _progress;
+    std::vector<std::jthread> _workers;
+};
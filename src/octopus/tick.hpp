@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cstdint>
+
+// Number of the ECS update a component was last changed in. Ticks start at 1,
+// so 0 can be used as "before anything happened".
+using Tick = uint32_t;
@@ -0,0 +1,143 @@
+#include "trace.hpp"
+
+#include "ring-buffer.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <thread>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::string_view levelName(TraceLevel level)
+{
+    switch (level) {
+        case TraceLevel::Info: return "info";
+        case TraceLevel::Debug: return "debug";
+        case TraceLevel::Verbose: return "verbose";
+    }
+    return "?";
+}
+
+// Owns the ring buffer and the thread writing it out. Lines are collected
+// into one string per batch, so output costs a single write per batch.
+class TraceSink {
+public:
+    TraceSink()
+        : _writer([this](const std::stop_token& stopToken) {
+            write(stopToken);
+        })
+    { }
+
+    ~TraceSink()
+    {
+        _writer.request_stop();
+        _writer.join();
+    }
+
+    void push(const TraceRecord& record)
+    {
+        if (!_records.tryPush(record)) {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    [[nodiscard]] uint64_t nanosecondsSinceStart() const
+    {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                Clock::now() - _start)
+                .count());
+    }
+
+private:
+    static constexpr size_t Capacity = 1 << 16;
+
+    void write(const std::stop_token& stopToken)
+    {
+        auto text = std::string{};
+        for (;;) {
+            auto stopping = stopToken.stop_requested();
+
+            text.clear();
+            auto record = TraceRecord{};
+            while (_records.tryPop(record)) {
+                std::format_to(
+                    std::back_inserter(text),
+                    "{:12.6f} {:>7} [{}] {}",
+                    static_cast<double>(record.nanoseconds) * 1e-9,
+                    levelName(record.level),
+                    record.span,
+                    record.message);
+                if (record.hasValue) {
+                    std::format_to(
+                        std::back_inserter(text), " {}", record.value);
+                }
+                text += '\n';
+            }
+            if (auto dropped = _dropped.exchange(0); dropped > 0) {
+                std::format_to(
+                    std::back_inserter(text),
+                    "trace: dropped {} records\n",
+                    dropped);
+            }
+            if (!text.empty()) {
+                std::cerr << text << std::flush;
+            }
+
+            if (stopping) {
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds{5});
+        }
+    }
+
+    Clock::time_point _start = Clock::now();
+    RingBuffer<TraceRecord, Capacity> _records;
+    std::atomic<uint64_t> _dropped = 0;
+    std::jthread _writer;
+};
+
+TraceSink& sink()
+{
+    static auto sink = TraceSink{};
+    return sink;
+}
+
+} // namespace
+
+SpanId newTraceSpan()
+{
+    static auto next = std::atomic<SpanId>{1};
+    return next.fetch_add(1, std::memory_order_relaxed);
+}
+
+void submitTrace(TraceLevel level, SpanId span, std::string_view message)
+{
+    auto& traceSink = sink();
+    traceSink.push(TraceRecord{
+        .nanoseconds = traceSink.nanosecondsSinceStart(),
+        .level = level,
+        .span = span,
+        .message = message,
+    });
+}
+
+void submitTrace(
+    TraceLevel level, SpanId span, std::string_view message, double value)
+{
+    auto& traceSink = sink();
+    traceSink.push(TraceRecord{
+        .nanoseconds = traceSink.nanosecondsSinceStart(),
+        .level = level,
+        .span = span,
+        .message = message,
+        .value = value,
+        .hasValue = true,
+    });
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+// Highest trace level compiled in; set through the OCTOPUS_TRACE_LEVEL CMake
+// cache variable. Calls above it compile to nothing.
+#ifndef OCTOPUS_TRACE_LEVEL
+#define OCTOPUS_TRACE_LEVEL 0
+#endif
+
+enum class TraceLevel : int {
+    // Rare, significant events.
+    Info = 1,
+    // Coroutine lifetimes and AI decisions.
+    Debug = 2,
+    // Per-tick details.
+    Verbose = 3,
+};
+
+// Identifies a coroutine (or any other traced activity) across records.
+using SpanId = uint32_t;
+
+// A trace record. Messages are not copied, so they must be string literals
+// or otherwise outlive the program's tracing.
+struct TraceRecord {
+    uint64_t nanoseconds = 0;
+    TraceLevel level = TraceLevel::Info;
+    SpanId span = 0;
+    std::string_view message;
+    double value = 0.0;
+    bool hasValue = false;
+};
+
+template <TraceLevel Level>
+constexpr bool traceEnabled()
+{
+    return static_cast<int>(Level) <= OCTOPUS_TRACE_LEVEL;
+}
+
+SpanId newTraceSpan();
+void submitTrace(TraceLevel level, SpanId span, std::string_view message);
+void submitTrace(
+    TraceLevel level, SpanId span, std::string_view message, double value);
+
+// Records are queued in a lock-free ring buffer and written out by a
+// background thread, so tracing never blocks on output. When the buffer is
+// full, records are dropped and counted.
+template <TraceLevel Level>
+void trace(SpanId span, std::string_view message)
+{
+    if constexpr (traceEnabled<Level>()) {
+        submitTrace(Level, span, message);
+    }
+}
+
+template <TraceLevel Level>
+void trace(SpanId span, std::string_view message, double value)
+{
+    if constexpr (traceEnabled<Level>()) {
+        submitTrace(Level, span, message, value);
+    }
+}
+
+// A fresh span id, or 0 when tracing is compiled out.
+inline SpanId traceSpan()
+{
+    if constexpr (OCTOPUS_TRACE_LEVEL > 0) {
+        return newTraceSpan();
+    } else {
+        return 0;
+    }
+}
@@ -3,14 +3,13 @@
 #include "ai.hpp"
 #include "events.hpp"
 
+#include <chrono>
 #include <format>
 #include <iostream>
 
 void updateHero(Ecs& ecs, float delta)
 {
-    for (auto& entity : ecs.entities<SmoothMovementComponent>()) {
-        auto& c = ecs.component<SmoothMovementComponent>(entity);
-
+    for (auto [entity, c] : ecs.view<SmoothMovementComponent>()) {
         c.velocity += c.acceleration() * c.control * delta;
 
         auto sqSpeed = c.velocity.sqLength();
@@ -25,54 +24,47 @@ void updateHero(Ecs& ecs, float delta)
             c.velocity *= desiredSpeed / speed;
         }
 
-        c.position += c.velocity * delta;
-
-        events.push(MoveObjectEvent{
-            .id = entity,
-            .position = c.position,
-            .height = c.height,
-        });
-    }
-}
-
-void updateBrains(Ecs& ecs, float delta)
-{
-    for (auto& ai : ecs.components<AiComponent>()) {
-        ai.brain.update(delta);
+        if (c.velocity.sqLength() > 0) {
+            c.position += c.velocity * delta;
+            ecs.markChanged<SmoothMovementComponent>(entity);
+        }
     }
 }
 
-void updateEnemies(Ecs& ecs, float delta)
+void updateEnemies(Ecs& ecs, ThreadPool& pool, float delta)
 {
-    for (auto entity : ecs.entities<SimpleMovementComponent>()) {
-        auto& mov = ecs.component<SimpleMovementComponent>(entity);
-
-        mov.position += mov.velocity * delta;
+    parallelEach(
+        pool,
+        ecs.view<SimpleMovementComponent>(),
+        1024,
+        [&ecs, delta](Entity entity, SimpleMovementComponent& mov) {
+            if (mov.velocity.sqLength() == 0 && mov.height == 0.f &&
+                mov.verticalVelocity == 0.f) {
+                return;
+            }
 
-        mov.height = std::max(0.f, mov.height + mov.verticalVelocity * delta);
-        mov.verticalVelocity -= mov.gravity * delta;
-        if (mov.height == 0.f) {
-            mov.verticalVelocity = 0.f;
-        }
+            mov.position += mov.velocity * delta;
 
-        events.push(MoveObjectEvent{
-            .id = entity,
-            .position = mov.position,
-            .height = mov.height,
+            mov.height =
+                std::max(0.f, mov.height + mov.verticalVelocity * delta);
+            mov.verticalVelocity -= mov.gravity * delta;
+            if (mov.height == 0.f) {
+                mov.verticalVelocity = 0.f;
+            }
+            ecs.markChanged<SimpleMovementComponent>(entity);
         });
-    }
 }
 
 World::World()
 {
-    auto hero = _ecs.create();
+    _hero = _ecs.create();
     _ecs.add(
-        hero,
+        _hero,
         SmoothMovementComponent{
             .position = {0, 0},
         });
     events.push(AddObjectEvent{
-        .id = hero,
+        .id = _hero,
         .type = ObjectType::Hero,
     });
 
@@ -86,8 +78,9 @@ World::World()
         scorpion,
         AiComponent{
             .homePoint = {-5, 3},
-            .brain = think("think", _ecs, scorpion),
+            .brain = think("think", _ecs, scorpion, _heroSnapshot),
         });
+    _brains.add(scorpion);
     events.push(AddObjectEvent{
         .id = scorpion,
         .type = ObjectType::Scorpion,
@@ -130,16 +123,74 @@ World::World()
         .type = ObjectType::House,
         .position = {-2, -4},
     });
+
+    // AI gets at most a millisecond per rendered frame, and scorpions far
+    // from the hero steer less often.
+    _brains.budget(std::chrono::microseconds{1000});
+    _brains.lod({
+        {.distance = 20.f, .interval = 0.1f},
+        {.distance = 40.f, .interval = 0.5f},
+    });
+
+    _scheduler.add({
+        .name = "hero",
+        .reads = {},
+        .writes = componentIds<SmoothMovementComponent>(),
+        .run = [this](float delta) { updateHero(_ecs, delta); },
+    });
+    _scheduler.add({
+        .name = "brains",
+        .reads = componentIds<SmoothMovementComponent>(),
+        .writes = componentIds<AiComponent, SimpleMovementComponent>(),
+        .run =
+            [this](float delta) {
+                _heroSnapshot = _ecs.component<SmoothMovementComponent>(_hero);
+                _brains.update(
+                    _ecs, _threadPool, delta, _heroSnapshot.position);
+            },
+    });
+    _scheduler.add({
+        .name = "enemies",
+        .reads = {},
+        .writes = componentIds<SimpleMovementComponent>(),
+        .run =
+            [this](float delta) { updateEnemies(_ecs, _threadPool, delta); },
+    });
+}
+
+void World::beginFrame()
+{
+    _brains.beginFrame();
 }
 
 void World::update(float delta)
 {
-    updateHero(_ecs, delta);
-    updateBrains(_ecs, delta);
-    updateEnemies(_ecs, delta);
+    _scheduler.run(_threadPool, delta);
+    _ecs.flush();
+}
+
+void World::sync()
+{
+    _ecs.eachChanged<SmoothMovementComponent>(
+        _syncedTick, [](Entity entity, const SmoothMovementComponent& c) {
+            events.push(MoveObjectEvent{
+                .id = entity,
+                .position = c.position,
+                .height = c.height,
+            });
+        });
+    _ecs.eachChanged<SimpleMovementComponent>(
+        _syncedTick, [](Entity entity, const SimpleMovementComponent& mov) {
+            events.push(MoveObjectEvent{
+                .id = entity,
+                .position = mov.position,
+                .height = mov.height,
+            });
+        });
+    _syncedTick = _ecs.tick();
 }
 
 WorldVector& World::heroControl()
 {
-    return _ecs.components<SmoothMovementComponent>().front().control;
+    return _ecs.component<SmoothMovementComponent>(_hero).control;
 }
@@ -1,8 +1,12 @@
 #pragma once
 
+#include "brain-scheduler.hpp"
 #include "ecs.hpp"
 #include "geometry.hpp"
+#include "scheduler.hpp"
+#include "stable-storage.hpp"
 #include "task.hpp"
+#include "thread-pool.hpp"
 
 #include <vector>
 
@@ -46,6 +50,13 @@ struct AiComponent {
     CoroTask brain;
 };
 
+// Brains keep references to these across suspensions, so they must not move
+// while other entities come and go.
+template <>
+constexpr bool stableStorage<SimpleMovementComponent> = true;
+template <>
+constexpr bool stableStorage<AiComponent> = true;
+
 struct PositionComponent {
     WorldPosition position;
     float radius = 0.f;
@@ -63,10 +74,23 @@ class World {
 public:
     World();
 
+    // Call once per rendered frame, before its updates; they share the AI
+    // budget.
+    void beginFrame();
     void update(float delta);
 
+    // Pushes a MoveObjectEvent for every entity that moved since the last
+    // sync.
+    void sync();
+
     WorldVector& heroControl();
 
 private:
     Ecs _ecs;
+    Entity _hero;
+    SmoothMovementComponent _heroSnapshot;
+    Tick _syncedTick = 0;
+    BrainScheduler _brains;
+    ThreadPool _threadPool;
+    Scheduler _scheduler;
 };
@@ -7,6 +7,8 @@
 #include <filesystem>
 #include <memory>
 #include <optional>
+#include <span>
+#include <vector>
 
 namespace helper {
 
@@ -53,14 +55,21 @@ public:
     Init& operator=(Init&&) = delete;
 };
 
+struct Size {
+    int w = 0;
+    int h = 0;
+};
+
 class Surface : public helper::Wrapper<SDL_Surface, SDL_FreeSurface> {
 public:
     explicit Surface(SDL_Surface* ptr);
-};
+    // A transparent RGBA surface.
+    Surface(int w, int h);
 
-struct Size {
-    int w = 0;
-    int h = 0;
+    Size size() const;
+
+    // Copies the source pixels, alpha included, without blending.
+    void blit(Surface& source, const SDL_Rect& dstrect);
 };
 
 class Texture : public helper::Wrapper<SDL_Texture, SDL_DestroyTexture> {
@@ -89,12 +98,44 @@ public:
     void
     copy(Texture& texture, const SDL_Rect& srcrect, const SDL_FRect& dstrect);
 
+    void geometry(
+        Texture& texture,
+        std::span<const SDL_Vertex> vertices,
+        std::span<const int> indices);
+
     void setDrawColor(uint8_t r, uint8_t g, uint8_t b, uint8_t a);
 
     void clear();
     void present();
 };
 
+// Collects textured quads and draws every run of consecutive quads sharing a
+// texture with a single SDL_RenderGeometry call, so quads are drawn in the
+// order they were added.
+class SpriteBatch {
+public:
+    void
+    add(Texture& texture, const SDL_Rect& srcrect, const SDL_FRect& dstrect);
+
+    // Draws everything collected since the last call.
+    void draw(Renderer& renderer);
+
+    // Draw calls issued by the last draw().
+    [[nodiscard]] size_t drawCalls() const;
+
+private:
+    struct Run {
+        Texture* texture = nullptr;
+        Size size;
+        size_t vertexCount = 0;
+    };
+
+    std::vector<SDL_Vertex> _vertices;
+    std::vector<Run> _runs;
+    std::vector<int> _indices;
+    size_t _drawCalls = 0;
+};
+
 class RWops : public helper::Wrapper<SDL_RWops, [](SDL_RWops* ops) {
     SDL_RWclose(ops);
 }> {
@@ -21,6 +21,24 @@ Surface::Surface(SDL_Surface* ptr)
     _ptr.reset(ptr);
 }
 
+Surface::Surface(int w, int h)
+{
+    _ptr.reset(check(
+        SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_RGBA32)));
+}
+
+Size Surface::size() const
+{
+    return Size{.w = _ptr->w, .h = _ptr->h};
+}
+
+void Surface::blit(Surface& source, const SDL_Rect& dstrect)
+{
+    auto target = dstrect;
+    check(SDL_SetSurfaceBlendMode(source.ptr(), SDL_BLENDMODE_NONE));
+    check(SDL_BlitSurface(source.ptr(), nullptr, ptr(), &target));
+}
+
 Texture::Texture(SDL_Texture* ptr)
 {
     _ptr.reset(ptr);
@@ -72,6 +90,20 @@ void Renderer::copy(
     check(SDL_RenderCopyF(ptr(), texture.ptr(), &srcrect, &dstrect));
 }
 
+void Renderer::geometry(
+    Texture& texture,
+    std::span<const SDL_Vertex> vertices,
+    std::span<const int> indices)
+{
+    check(SDL_RenderGeometry(
+        ptr(),
+        texture.ptr(),
+        vertices.data(),
+        static_cast<int>(vertices.size()),
+        indices.data(),
+        static_cast<int>(indices.size())));
+}
+
 void Renderer::setDrawColor(uint8_t r, uint8_t g, uint8_t b, uint8_t a)
 {
     check(SDL_SetRenderDrawColor(ptr(), r, g, b, a));
@@ -87,6 +119,62 @@ void Renderer::present()
     SDL_RenderPresent(ptr());
 }
 
+void SpriteBatch::add(
+    Texture& texture, const SDL_Rect& srcrect, const SDL_FRect& dstrect)
+{
+    if (_runs.empty() || _runs.back().texture != &texture) {
+        _runs.push_back(Run{.texture = &texture, .size = texture.size()});
+    }
+    auto& run = _runs.back();
+
+    auto u0 = (float)srcrect.x / (float)run.size.w;
+    auto v0 = (float)srcrect.y / (float)run.size.h;
+    auto u1 = (float)(srcrect.x + srcrect.w) / (float)run.size.w;
+    auto v1 = (float)(srcrect.y + srcrect.h) / (float)run.size.h;
+    auto x0 = dstrect.x;
+    auto y0 = dstrect.y;
+    auto x1 = dstrect.x + dstrect.w;
+    auto y1 = dstrect.y + dstrect.h;
+
+    static constexpr auto white = SDL_Color{255, 255, 255, 255};
+    _vertices.push_back({{x0, y0}, white, {u0, v0}});
+    _vertices.push_back({{x1, y0}, white, {u1, v0}});
+    _vertices.push_back({{x1, y1}, white, {u1, v1}});
+    _vertices.push_back({{x0, y1}, white, {u0, v1}});
+    run.vertexCount += 4;
+}
+
+void SpriteBatch::draw(Renderer& renderer)
+{
+    _drawCalls = 0;
+    auto vertices = std::span<const SDL_Vertex>{_vertices};
+    for (const auto& run : _runs) {
+        // Two triangles per quad. Every run starts at vertex 0 of its own
+        // span, so all runs share one index buffer.
+        auto indexCount = run.vertexCount / 4 * 6;
+        while (_indices.size() < indexCount) {
+            auto vertex = static_cast<int>(_indices.size() / 6 * 4);
+            for (auto corner : {0, 1, 2, 0, 2, 3}) {
+                _indices.push_back(vertex + corner);
+            }
+        }
+
+        renderer.geometry(
+            *run.texture,
+            vertices.first(run.vertexCount),
+            std::span{_indices}.first(indexCount));
+        vertices = vertices.subspan(run.vertexCount);
+        _drawCalls++;
+    }
+    _vertices.clear();
+    _runs.clear();
+}
+
+size_t SpriteBatch::drawCalls() const
+{
+    return _drawCalls;
+}
+
 RWops::RWops(const std::filesystem::path& file, const char* mode)
 {
     _ptr.reset(check(SDL_RWFromFile(file.string().c_str(), mode)));